@@ -26,9 +26,11 @@ libbase_src_files := \
 
 libbase_linux_src_files := \
     errors_unix.cpp \
+    mapped_file.cpp \
 
 libbase_darwin_src_files := \
     errors_unix.cpp \
+    mapped_file.cpp \
 
 libbase_windows_src_files := \
     errors_windows.cpp \
@@ -44,6 +46,12 @@ libbase_test_src_files := \
     strings_test.cpp \
     test_main.cpp \
 
+libbase_test_linux_src_files := \
+    mapped_file_test.cpp \
+
+libbase_test_darwin_src_files := \
+    mapped_file_test.cpp \
+
 libbase_test_windows_src_files := \
     utf8_test.cpp \
 
@@ -112,7 +120,7 @@ include $(BUILD_HOST_SHARED_LIBRARY)
 include $(CLEAR_VARS)
 LOCAL_MODULE := libbase_test
 LOCAL_CLANG := true
-LOCAL_SRC_FILES := $(libbase_test_src_files)
+LOCAL_SRC_FILES := $(libbase_test_src_files) $(libbase_test_linux_src_files)
 LOCAL_SRC_FILES_darwin := $(libbase_test_darwin_src_files)
 LOCAL_SRC_FILES_linux := $(libbase_test_linux_src_files)
 LOCAL_SRC_FILES_windows := $(libbase_test_windows_src_files)
@@ -138,3 +146,17 @@ LOCAL_MULTILIB := both
 LOCAL_MODULE_STEM_32 := $(LOCAL_MODULE)32
 LOCAL_MODULE_STEM_64 := $(LOCAL_MODULE)64
 include $(BUILD_HOST_NATIVE_TEST)
+
+# Benchmarks
+# ------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+LOCAL_MODULE := libbase_benchmark
+LOCAL_CLANG := true
+LOCAL_SRC_FILES := \
+    benchmark_main.cpp \
+    file_benchmark.cpp \
+    logging_benchmark.cpp \
+
+LOCAL_CPPFLAGS := $(libbase_cppflags)
+LOCAL_SHARED_LIBRARIES := libbase
+include $(BUILD_NATIVE_BENCHMARK)
@@ -18,6 +18,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -38,6 +39,30 @@ using namespace android::base::utf8;
 bool ReadFdToString(int fd, std::string* content) {
   content->clear();
 
+  // Regular files are read straight into a string of the right size, rather
+  // than through a buffer into a string that keeps growing. The size is only
+  // a hint: the file may be truncated or appended to while we read it, and
+  // anything past it is picked up by the loop below. Files in procfs and
+  // sysfs report a size of 0 and only take that loop.
+  struct stat sb;
+  if (fstat(fd, &sb) != -1 && S_ISREG(sb.st_mode) && sb.st_size > 0 &&
+      static_cast<uint64_t>(sb.st_size) < content->max_size()) {
+    const size_t size = sb.st_size;
+    content->resize(size);
+    size_t pos = 0;
+    while (pos < size) {
+      ssize_t n = TEMP_FAILURE_RETRY(read(fd, &(*content)[pos], size - pos));
+      if (n == -1) {
+        return false;
+      }
+      if (n == 0) {
+        content->resize(pos);
+        return true;
+      }
+      pos += n;
+    }
+  }
+
   char buf[BUFSIZ];
   ssize_t n;
   while ((n = TEMP_FAILURE_RETRY(read(fd, &buf[0], sizeof(buf)))) > 0) {
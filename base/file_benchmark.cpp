@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "android-base/file.h"
+#include "android-base/mapped_file.h"
+#include "android-base/test_utils.h"
+
+// Sums the bytes so that mapped pages are actually read.
+static size_t Touch(const char* data, size_t size) {
+  size_t sum = 0;
+  for (size_t i = 0; i < size; i += 64) {
+    sum += data[i];
+  }
+  return sum;
+}
+
+static void BM_ReadFileToString_procfs(benchmark::State& state) {
+  std::string content;
+  while (state.KeepRunning()) {
+    android::base::ReadFileToString("/proc/self/status", &content);
+  }
+}
+BENCHMARK(BM_ReadFileToString_procfs);
+
+static void BM_ReadFileToString(benchmark::State& state) {
+  TemporaryFile tf;
+  android::base::WriteStringToFd(std::string(state.range_x(), 'x'), tf.fd);
+  std::string content;
+  while (state.KeepRunning()) {
+    android::base::ReadFileToString(tf.path, &content);
+    benchmark::DoNotOptimize(Touch(content.data(), content.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_ReadFileToString)->Range(4 << 10, 16 << 20);
+
+static void BM_MappedFile(benchmark::State& state) {
+  TemporaryFile tf;
+  android::base::WriteStringToFd(std::string(state.range_x(), 'x'), tf.fd);
+  while (state.KeepRunning()) {
+    std::unique_ptr<android::base::MappedFile> m =
+        android::base::MappedFile::FromPath(
+            tf.path, android::base::MappedFile::kSequential);
+    benchmark::DoNotOptimize(Touch(m->data(), m->size()));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_MappedFile)->Range(4 << 10, 16 << 20);
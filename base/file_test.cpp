@@ -45,6 +45,32 @@ TEST(file, ReadFileToString_WriteStringToFile) {
   EXPECT_EQ("abc", s);
 }
 
+TEST(file, ReadFdToString_large) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  std::string content;
+  for (size_t i = 0; i < 100000; ++i) {
+    content += static_cast<char>('a' + i % 26);
+  }
+  ASSERT_TRUE(android::base::WriteStringToFd(content, tf.fd));
+
+  // Reading starts from the current offset, short of the size fstat reports.
+  ASSERT_EQ(10, lseek(tf.fd, 10, SEEK_SET));
+  std::string s;
+  ASSERT_TRUE(android::base::ReadFdToString(tf.fd, &s)) << strerror(errno);
+  EXPECT_EQ(content.substr(10), s);
+}
+
+#if defined(__linux__)
+TEST(file, ReadFileToString_procfs) {
+  // procfs files report a size of 0.
+  std::string s;
+  ASSERT_TRUE(android::base::ReadFileToString("/proc/self/status", &s))
+    << strerror(errno);
+  EXPECT_NE(std::string::npos, s.find("Name:")) << s;
+}
+#endif
+
 // WriteStringToFile2 is explicitly for setting Unix permissions, which make no
 // sense on Windows.
 #if !defined(_WIN32)
@@ -79,14 +79,23 @@ class LogdLogger {
 // The tag (or '*' for the global level) comes first, followed by a colon and a
 // letter indicating the minimum priority level we're expected to log.  This can
 // be used to reveal or conceal logs with specific tags.
-extern void InitLogging(char* argv[], LogFunction&& logger);
+//
+// See SetLogger for concurrent.
+extern void InitLogging(char* argv[], LogFunction&& logger,
+                        bool concurrent = false);
 
 // Configures logging using the default logger (logd for the device, stderr for
 // the host).
 extern void InitLogging(char* argv[]);
 
 // Replace the current logger.
-extern void SetLogger(LogFunction&& logger);
+//
+// Calls to the logger are serialized by a global lock unless concurrent is
+// true, which promises that the logger may be called from several threads at
+// once (as LogdLogger and StderrLogger can). Threads then format and log
+// their messages without contending on that lock, at the cost of the lines of
+// multi-line messages possibly interleaving with those of other threads.
+extern void SetLogger(LogFunction&& logger, bool concurrent = false);
 
 // Get the minimum severity level for logging.
 extern LogSeverity GetMinimumLogSeverity();
@@ -317,7 +326,8 @@ class LogMessage {
                       LogSeverity severity, const char* msg);
 
  private:
-  const std::unique_ptr<LogMessageData> data_;
+  // Owned, but usually recycled for the thread's next message.
+  LogMessageData* const data_;
 
   DISALLOW_COPY_AND_ASSIGN(LogMessage);
 };
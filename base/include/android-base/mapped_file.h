@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_BASE_MAPPED_FILE_H
+#define ANDROID_BASE_MAPPED_FILE_H
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "android-base/macros.h"
+
+#if defined(_WIN32)
+#error MappedFile is not available on Windows
+#endif
+
+namespace android {
+namespace base {
+
+// A read-only mapping of a whole regular file, unmapped when it goes out of
+// scope. Unlike ReadFileToString, the contents are not copied: pages are
+// read in on first access and shared with the page cache.
+//
+//      std::unique_ptr<MappedFile> config =
+//          MappedFile::FromPath("/system/etc/foo.conf", MappedFile::kSequential);
+//      if (config == nullptr) return error;
+//      Parse(config->data(), config->size());
+//
+// Only regular files can be mapped; use ReadFileToString for procfs and
+// sysfs. The mapping does not follow changes to the file's size, and
+// accessing pages past the end of a file truncated in the meantime raises
+// SIGBUS, so only map files that are not modified while in use.
+class MappedFile {
+ public:
+  // How the contents will be accessed, passed on to madvise(2).
+  enum Advice {
+    kNormal,
+    // Read once from start to end: read ahead aggressively.
+    kSequential,
+    // Looked up at random offsets: don't read ahead.
+    kRandom,
+    // About to be read in full: start reading it all in now.
+    kWillNeed,
+  };
+
+  // Returns nullptr with errno set on failure. errno is EINVAL if fd is not a
+  // regular file. The fd is not closed, and may be closed once this returns.
+  static std::unique_ptr<MappedFile> FromFd(int fd, Advice advice = kNormal);
+  static std::unique_ptr<MappedFile> FromPath(const std::string& path,
+                                              Advice advice = kNormal);
+
+  ~MappedFile();
+
+  // The contents of the file, which are not NUL terminated. An empty file
+  // has a size of 0 and a non-null data().
+  const char* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  MappedFile(const char* data, size_t size) : data_(data), size_(size) {
+  }
+
+  const char* const data_;
+  const size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace base
+}  // namespace android
+
+#endif  // ANDROID_BASE_MAPPED_FILE_H
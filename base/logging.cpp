@@ -29,6 +29,7 @@
 #include <errno.h>
 #endif
 
+#include <atomic>
 #include <iostream>
 #include <limits>
 #include <sstream>
@@ -38,6 +39,7 @@
 
 #ifndef _WIN32
 #include <mutex>
+#include <pthread.h>
 #endif
 
 #include "android-base/macros.h"
@@ -162,26 +164,49 @@ namespace base {
 
 static auto& logging_lock = *new mutex();
 
+struct Logger {
+  Logger(LogFunction&& function, bool concurrent)
+      : function(std::move(function)), concurrent(concurrent) {
+  }
+
+  const LogFunction function;
+  // Whether function may be called without holding logging_lock.
+  const bool concurrent;
+};
+
+// Replaced loggers are never freed: a concurrent one may still be running on
+// other threads, and SetLogger() is only called a handful of times.
 #ifdef __ANDROID__
-static auto& gLogger = *new LogFunction(LogdLogger());
+static std::atomic<Logger*> gLogger(new Logger(LogdLogger(), false));
 #else
-static auto& gLogger = *new LogFunction(StderrLogger);
+static std::atomic<Logger*> gLogger(new Logger(StderrLogger, false));
 #endif
 
 static bool gInitialized = false;
 static LogSeverity gMinimumLogSeverity = INFO;
-static auto& gProgramInvocationName = *new std::unique_ptr<std::string>();
+// Like loggers, names are never freed once published: a concurrent logger
+// may still be printing one that InitLogging() has since replaced.
+static std::atomic<const std::string*> gProgramInvocationName(nullptr);
 
 LogSeverity GetMinimumLogSeverity() {
   return gMinimumLogSeverity;
 }
 
 static const char* ProgramInvocationName() {
-  if (gProgramInvocationName == nullptr) {
-    gProgramInvocationName.reset(new std::string(getprogname()));
+  const std::string* name = gProgramInvocationName.load(std::memory_order_acquire);
+  if (name == nullptr) {
+    const std::string* initial = new std::string(getprogname());
+    if (gProgramInvocationName.compare_exchange_strong(name, initial,
+                                                       std::memory_order_acq_rel,
+                                                       std::memory_order_acquire)) {
+      name = initial;
+    } else {
+      // Another thread got there first.
+      delete initial;
+    }
   }
 
-  return gProgramInvocationName->c_str();
+  return name->c_str();
 }
 
 void StderrLogger(LogId, LogSeverity severity, const char*, const char* file,
@@ -232,9 +257,10 @@ void LogdLogger::operator()(LogId id, LogSeverity severity, const char* tag,
 }
 #endif
 
-void InitLogging(char* argv[], LogFunction&& logger) {
-  SetLogger(std::forward<LogFunction>(logger));
+void InitLogging(char* argv[], LogFunction&& logger, bool concurrent) {
+  // Name the program before a concurrent logger can run and print it.
   InitLogging(argv);
+  SetLogger(std::forward<LogFunction>(logger), concurrent);
 }
 
 void InitLogging(char* argv[]) {
@@ -248,7 +274,8 @@ void InitLogging(char* argv[]) {
   // Linux to recover this, but we don't have that luxury on the Mac/Windows,
   // and there are a couple of argv[0] variants that are commonly used.
   if (argv != nullptr) {
-    gProgramInvocationName.reset(new std::string(basename(argv[0])));
+    gProgramInvocationName.store(new std::string(basename(argv[0])),
+                                 std::memory_order_release);
   }
 
   const char* tags = getenv("ANDROID_LOG_TAGS");
@@ -292,9 +319,12 @@ void InitLogging(char* argv[]) {
   }
 }
 
-void SetLogger(LogFunction&& logger) {
+void SetLogger(LogFunction&& logger, bool concurrent) {
+  Logger* new_logger = new Logger(std::move(logger), concurrent);
   lock_guard<mutex> lock(logging_lock);
-  gLogger = std::move(logger);
+  // Make sure the tag exists before it can be read without the lock.
+  ProgramInvocationName();
+  gLogger.store(new_logger, std::memory_order_release);
 }
 
 static const char* GetFileBasename(const char* file) {
@@ -326,6 +356,22 @@ class LogMessageData {
         error_(error) {
   }
 
+  // Prepares a recycled instance for a new message, as if newly constructed.
+  void Reset(const char* file, unsigned int line, LogId id,
+             LogSeverity severity, int error) {
+    buffer_.str(std::string());
+    buffer_.clear();
+    buffer_.flags(std::ios_base::skipws | std::ios_base::dec);
+    buffer_.precision(6);
+    buffer_.width(0);
+    buffer_.fill(' ');
+    file_ = GetFileBasename(file);
+    line_number_ = line;
+    id_ = id;
+    severity_ = severity;
+    error_ = error;
+  }
+
   const char* GetFile() const {
     return file_;
   }
@@ -356,18 +402,86 @@ class LogMessageData {
 
  private:
   std::ostringstream buffer_;
-  const char* const file_;
-  const unsigned int line_number_;
-  const LogId id_;
-  const LogSeverity severity_;
-  const int error_;
+  const char* file_;
+  unsigned int line_number_;
+  LogId id_;
+  LogSeverity severity_;
+  int error_;
 
   DISALLOW_COPY_AND_ASSIGN(LogMessageData);
 };
 
+// Constructing a stream costs more than formatting most messages, so each
+// thread keeps the LogMessageData of its last message for the next one. A
+// message logged while another is being formatted (from an operator<<) gets
+// a new one.
+#if !defined(_WIN32)
+static pthread_key_t gLogMessageDataKey;
+static pthread_once_t gLogMessageDataKeyOnce = PTHREAD_ONCE_INIT;
+
+static void DeleteLogMessageData(void* data) {
+  delete static_cast<LogMessageData*>(data);
+}
+
+static void CreateLogMessageDataKey() {
+  pthread_key_create(&gLogMessageDataKey, DeleteLogMessageData);
+}
+
+static LogMessageData* AcquireLogMessageData(const char* file,
+                                             unsigned int line, LogId id,
+                                             LogSeverity severity, int error) {
+  pthread_once(&gLogMessageDataKeyOnce, CreateLogMessageDataKey);
+  LogMessageData* data =
+      static_cast<LogMessageData*>(pthread_getspecific(gLogMessageDataKey));
+  if (data == nullptr) {
+    return new LogMessageData(file, line, id, severity, error);
+  }
+  pthread_setspecific(gLogMessageDataKey, nullptr);
+  data->Reset(file, line, id, severity, error);
+  return data;
+}
+
+static void ReleaseLogMessageData(LogMessageData* data) {
+  if (pthread_getspecific(gLogMessageDataKey) == nullptr) {
+    pthread_setspecific(gLogMessageDataKey, data);
+  } else {
+    delete data;
+  }
+}
+#else
+static LogMessageData* AcquireLogMessageData(const char* file,
+                                             unsigned int line, LogId id,
+                                             LogSeverity severity, int error) {
+  return new LogMessageData(file, line, id, severity, error);
+}
+
+static void ReleaseLogMessageData(LogMessageData* data) {
+  delete data;
+}
+#endif
+
+static void LogLines(const Logger* logger, const LogMessageData* data,
+                     std::string& msg) {
+  const char* tag = ProgramInvocationName();
+  if (msg.find('\n') == std::string::npos) {
+    logger->function(data->GetId(), data->GetSeverity(), tag, data->GetFile(),
+                     data->GetLineNumber(), msg.c_str());
+  } else {
+    msg += '\n';
+    size_t i = 0;
+    while (i < msg.size()) {
+      size_t nl = msg.find('\n', i);
+      msg[nl] = '\0';
+      logger->function(data->GetId(), data->GetSeverity(), tag,
+                       data->GetFile(), data->GetLineNumber(), &msg[i]);
+      i = nl + 1;
+    }
+  }
+}
+
 LogMessage::LogMessage(const char* file, unsigned int line, LogId id,
                        LogSeverity severity, int error)
-    : data_(new LogMessageData(file, line, id, severity, error)) {
+    : data_(AcquireLogMessageData(file, line, id, severity, error)) {
 }
 
 LogMessage::~LogMessage() {
@@ -377,27 +491,20 @@ LogMessage::~LogMessage() {
   }
   std::string msg(data_->ToString());
 
-  {
+  const Logger* logger = gLogger.load(std::memory_order_acquire);
+  if (logger->concurrent) {
+    LogLines(logger, data_, msg);
+  } else {
     // Do the actual logging with the lock held.
     lock_guard<mutex> lock(logging_lock);
-    if (msg.find('\n') == std::string::npos) {
-      LogLine(data_->GetFile(), data_->GetLineNumber(), data_->GetId(),
-              data_->GetSeverity(), msg.c_str());
-    } else {
-      msg += '\n';
-      size_t i = 0;
-      while (i < msg.size()) {
-        size_t nl = msg.find('\n', i);
-        msg[nl] = '\0';
-        LogLine(data_->GetFile(), data_->GetLineNumber(), data_->GetId(),
-                data_->GetSeverity(), &msg[i]);
-        i = nl + 1;
-      }
-    }
+    LogLines(gLogger.load(std::memory_order_relaxed), data_, msg);
   }
 
+  const LogSeverity severity = data_->GetSeverity();
+  ReleaseLogMessageData(data_);
+
   // Abort if necessary.
-  if (data_->GetSeverity() == FATAL) {
+  if (severity == FATAL) {
 #ifdef __ANDROID__
     android_set_abort_message(msg.c_str());
 #endif
@@ -412,7 +519,8 @@ std::ostream& LogMessage::stream() {
 void LogMessage::LogLine(const char* file, unsigned int line, LogId id,
                          LogSeverity severity, const char* message) {
   const char* tag = ProgramInvocationName();
-  gLogger(id, severity, tag, file, line, message);
+  gLogger.load(std::memory_order_acquire)->function(id, severity, tag, file,
+                                                    line, message);
 }
 
 ScopedLogSeverity::ScopedLogSeverity(LogSeverity level) {
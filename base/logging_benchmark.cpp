@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/logging.h"
+
+#include <benchmark/benchmark.h>
+
+// Measures LOG() itself, so the logger throws the messages away.
+static void NullLogger(android::base::LogId, android::base::LogSeverity,
+                       const char*, const char*, unsigned int, const char*) {
+}
+
+static void BM_LOG_serialized(benchmark::State& state) {
+  android::base::SetLogger(NullLogger);
+  while (state.KeepRunning()) {
+    LOG(INFO) << "message " << state.iterations();
+  }
+}
+BENCHMARK(BM_LOG_serialized)->ThreadRange(1, 8);
+
+static void BM_LOG_concurrent(benchmark::State& state) {
+  android::base::SetLogger(NullLogger, true);
+  while (state.KeepRunning()) {
+    LOG(INFO) << "message " << state.iterations();
+  }
+}
+BENCHMARK(BM_LOG_concurrent)->ThreadRange(1, 8);
+
+static void BM_LOG_filtered(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    LOG(VERBOSE) << "message " << state.iterations();
+  }
+}
+BENCHMARK(BM_LOG_filtered)->ThreadRange(1, 8);
@@ -22,8 +22,11 @@
 #include <signal.h>
 #endif
 
+#include <atomic>
 #include <regex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "android-base/file.h"
 #include "android-base/stringprintf.h"
@@ -279,3 +282,79 @@ TEST(logging, UNIMPLEMENTED) {
 #endif
   }
 }
+
+TEST(logging, LOG_stream_state_is_reset) {
+  std::vector<std::string> messages;
+  android::base::SetLogger([&messages](android::base::LogId,
+                                       android::base::LogSeverity, const char*,
+                                       const char*, unsigned int,
+                                       const char* message) {
+    messages.push_back(message);
+  });
+
+  LOG(INFO) << std::hex << 255;
+  LOG(INFO) << 255;
+  android::base::SetLogger(android::base::StderrLogger);
+
+  ASSERT_EQ(2U, messages.size());
+  EXPECT_EQ("ff", messages[0]);
+  EXPECT_EQ("255", messages[1]);
+}
+
+struct Nested {
+};
+
+static std::ostream& operator<<(std::ostream& os, const Nested&) {
+  LOG(INFO) << "inner";
+  return os << "outer";
+}
+
+TEST(logging, LOG_nested) {
+  std::vector<std::string> messages;
+  android::base::SetLogger([&messages](android::base::LogId,
+                                       android::base::LogSeverity, const char*,
+                                       const char*, unsigned int,
+                                       const char* message) {
+    messages.push_back(message);
+  });
+
+  LOG(INFO) << "before " << Nested() << " after";
+  android::base::SetLogger(android::base::StderrLogger);
+
+  ASSERT_EQ(2U, messages.size());
+  EXPECT_EQ("inner", messages[0]);
+  EXPECT_EQ("before outer after", messages[1]);
+}
+
+#if !defined(_WIN32)
+TEST(logging, LOG_concurrent) {
+  const int kThreads = 8;
+  const int kMessages = 1000;
+  std::atomic<int> count(0);
+  std::atomic<int> lines(0);
+  android::base::SetLogger([&](android::base::LogId, android::base::LogSeverity,
+                               const char*, const char*, unsigned int,
+                               const char* message) {
+    ++lines;
+    if (strcmp(message, "second") == 0) {
+      ++count;
+    }
+  }, true);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < kMessages; ++j) {
+        LOG(INFO) << "first\nsecond";
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  android::base::SetLogger(android::base::StderrLogger);
+
+  EXPECT_EQ(kThreads * kMessages, count);
+  EXPECT_EQ(2 * kThreads * kMessages, lines);
+}
+#endif
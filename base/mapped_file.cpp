@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/mapped_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "android-base/unique_fd.h"
+
+namespace android {
+namespace base {
+
+static const int kAdviceToMadvise[] = {
+    MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED,
+};
+static_assert(arraysize(kAdviceToMadvise) == MappedFile::kWillNeed + 1,
+              "Mismatch in size of kAdviceToMadvise and values in Advice");
+
+std::unique_ptr<MappedFile> MappedFile::FromFd(int fd, Advice advice) {
+  struct stat sb;
+  if (fstat(fd, &sb) == -1) {
+    return nullptr;
+  }
+  if (!S_ISREG(sb.st_mode) || static_cast<uint64_t>(sb.st_size) > SIZE_MAX) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  // mmap(2) rejects empty mappings.
+  if (sb.st_size == 0) {
+    return std::unique_ptr<MappedFile>(new MappedFile("", 0));
+  }
+
+  const size_t size = sb.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  // The advice is only a hint, failing to take it isn't an error.
+  if (advice != kNormal) {
+    madvise(data, size, kAdviceToMadvise[advice]);
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(static_cast<const char*>(data), size));
+}
+
+std::unique_ptr<MappedFile> MappedFile::FromPath(const std::string& path,
+                                                 Advice advice) {
+  unique_fd fd(TEMP_FAILURE_RETRY(
+      open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
+  if (fd == -1) {
+    return nullptr;
+  }
+  return FromFd(fd, advice);
+}
+
+MappedFile::~MappedFile() {
+  if (size_ > 0) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+}  // namespace base
+}  // namespace android
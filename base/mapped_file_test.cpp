@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/mapped_file.h"
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+
+TEST(mapped_file, FromPath) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  std::string content(3 * 4096 + 17, 'x');
+  content[0] = 'a';
+  content[content.size() - 1] = 'z';
+  ASSERT_TRUE(android::base::WriteStringToFd(content, tf.fd));
+
+  std::unique_ptr<android::base::MappedFile> m =
+      android::base::MappedFile::FromPath(tf.path,
+                                          android::base::MappedFile::kSequential);
+  ASSERT_TRUE(m != nullptr) << strerror(errno);
+  ASSERT_EQ(content.size(), m->size());
+  EXPECT_EQ(content, std::string(m->data(), m->size()));
+}
+
+TEST(mapped_file, FromFd_empty) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  std::unique_ptr<android::base::MappedFile> m =
+      android::base::MappedFile::FromFd(tf.fd);
+  ASSERT_TRUE(m != nullptr) << strerror(errno);
+  EXPECT_EQ(0U, m->size());
+  EXPECT_TRUE(m->data() != nullptr);
+}
+
+TEST(mapped_file, FromFd_not_regular) {
+  TemporaryDir td;
+  int fd = open(td.path, O_RDONLY | O_DIRECTORY);
+  ASSERT_NE(-1, fd);
+  errno = 0;
+  EXPECT_TRUE(android::base::MappedFile::FromFd(fd) == nullptr);
+  EXPECT_EQ(EINVAL, errno);
+  close(fd);
+}
+
+TEST(mapped_file, FromPath_ENOENT) {
+  errno = 0;
+  EXPECT_TRUE(android::base::MappedFile::FromPath("/proc/does-not-exist") ==
+              nullptr);
+  EXPECT_EQ(ENOENT, errno);
+}
@@ -9,8 +9,14 @@
 #include <sys/stat.h>
 #include <dirent.h>
 
+#include <sys/mman.h>
+#include <sys/time.h>
+
 #include <stdarg.h>
 #include <fcntl.h>
+#include <pthread.h>
+
+#include <zlib.h>
 
 #include <private/android_filesystem_config.h>
 
@@ -21,6 +27,11 @@
 ** - dotfiles are ignored
 ** - directories named 'root' are ignored
 ** - device notes, pipes, etc are not supported (error)
+** - with -z the archive is written as a single gzip stream.  The cpio
+**   data is cut into fixed size chunks which are deflated in parallel
+**   (each primed with the previous chunk's tail as its dictionary) and
+**   stitched together with sync flushes, so the output only depends on
+**   the input and the compression level, never on the thread count.
 */
 
 void die(const char *why, ...)
@@ -54,6 +65,8 @@ static char *target_out_path = NULL;
 static int verbose = 0;
 static int total_size = 0;
 
+static void out_write(const void *data, size_t len);
+
 static void fix_stat(const char *path, struct stat *s)
 {
     uint64_t capabilities;
@@ -86,52 +99,59 @@ static void fix_stat(const char *path, struct stat *s)
     }
 }
 
+static void _pad(unsigned align)
+{
+    static const char zeros[256];
+    unsigned n = (align - (total_size & (align - 1))) & (align - 1);
+
+    if(n) {
+        out_write(zeros, n);
+        total_size += n;
+    }
+}
+
 static void _eject(struct stat *s, char *out, int olen, char *data, unsigned datasize)
 {
     // Nothing is special about this value, just picked something in the
     // approximate range that was being used already, and avoiding small
     // values which may be special.
     static unsigned next_inode = 300000;
+    char header[6 + 8*13 + 1];
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    _pad(4);
 
     fix_stat(out, s);
 //    fprintf(stderr, "_eject %s: mode=0%o\n", out, s->st_mode);
 
-    printf("%06x%08x%08x%08x%08x%08x%08x"
-           "%08x%08x%08x%08x%08x%08x%08x%s%c",
-           0x070701,
-           next_inode++,  //  s.st_ino,
-           s->st_mode,
-           0, // s.st_uid,
-           0, // s.st_gid,
-           1, // s.st_nlink,
-           0, // s.st_mtime,
-           datasize,
-           0, // volmajor
-           0, // volminor
-           0, // devmajor
-           0, // devminor,
-           olen + 1,
-           0,
-           out,
-           0
-           );
-
-    total_size += 6 + 8*13 + olen + 1;
+    snprintf(header, sizeof(header),
+             "%06x%08x%08x%08x%08x%08x%08x"
+             "%08x%08x%08x%08x%08x%08x%08x",
+             0x070701,
+             next_inode++,  //  s.st_ino,
+             s->st_mode,
+             0, // s.st_uid,
+             0, // s.st_gid,
+             1, // s.st_nlink,
+             0, // s.st_mtime,
+             datasize,
+             0, // volmajor
+             0, // volminor
+             0, // devmajor
+             0, // devminor,
+             olen + 1,
+             0
+             );
 
     if(strlen(out) != (unsigned int)olen) die("ACK!");
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    out_write(header, 6 + 8*13);
+    out_write(out, olen + 1);
+    total_size += 6 + 8*13 + olen + 1;
+
+    _pad(4);
 
     if(datasize) {
-        fwrite(data, datasize, 1, stdout);
+        out_write(data, datasize);
         total_size += datasize;
     }
 }
@@ -142,10 +162,7 @@ static void _eject_trailer()
     memset(&s, 0, sizeof(s));
     _eject(&s, "TRAILER!!!", 10, 0, 0);
 
-    while(total_size & 0xff) {
-        total_size++;
-        putchar(0);
-    }
+    _pad(256);
 }
 
 static void _archive(char *in, char *out, int ilen, int olen);
@@ -239,22 +256,20 @@ static void _archive(char *in, char *out, int ilen, int olen)
     if(lstat(in, &s)) die("could not stat '%s'\n", in);
 
     if(S_ISREG(s.st_mode)){
-        char *tmp;
+        char *tmp = NULL;
         int fd;
 
         fd = open(in, O_RDONLY);
         if(fd < 0) die("cannot open '%s' for read", in);
 
-        tmp = (char*) malloc(s.st_size);
-        if(tmp == 0) die("cannot allocate %d bytes", s.st_size);
-
-        if(read(fd, tmp, s.st_size) != s.st_size) {
-            die("cannot read %d bytes", s.st_size);
+        if(s.st_size > 0) {
+            tmp = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(tmp == MAP_FAILED) die("cannot map '%s'", in);
         }
 
         _eject(&s, out, olen, tmp, s.st_size);
 
-        free(tmp);
+        if(tmp) munmap(tmp, s.st_size);
         close(fd);
     } else if(S_ISDIR(s.st_mode)) {
         _eject(&s, out, olen, 0, 0);
@@ -281,6 +296,272 @@ void archive(const char *start, const char *prefix)
     _archive_dir(in, out, strlen(in), strlen(out));
 }
 
+/* Compressed output
+**
+** The cpio stream is cut into CHUNK_SIZE pieces.  Each piece is raw
+** deflated on its own (using the tail of the piece before it as the
+** preset dictionary) and ended with a sync flush, so the compressed
+** pieces can simply be concatenated into one gzip member.  The crc of
+** the whole stream is built with crc32_combine() as pieces are written.
+*/
+
+#define CHUNK_SIZE  (1024 * 1024)
+#define DICT_SIZE   32768
+#define MAX_THREADS 64
+
+enum { CHUNK_FREE, CHUNK_QUEUED, CHUNK_DONE };
+
+struct chunk {
+    unsigned char *in;
+    size_t in_len;
+    unsigned char dict[DICT_SIZE];
+    size_t dict_len;
+    unsigned char *out;
+    size_t out_len;
+    size_t out_size;
+    uLong crc;
+    int last;
+    int state;
+};
+
+static int compress_output = 0;
+static int compress_level = Z_DEFAULT_COMPRESSION;
+static int compress_threads = 0;
+
+static struct chunk *ring;
+static unsigned ring_size;
+static unsigned long next_fill;   /* chunk currently being filled */
+static unsigned long next_job;    /* next chunk a worker should take */
+static unsigned long next_write;  /* next chunk to go to stdout */
+static unsigned char tail[DICT_SIZE];
+static size_t tail_len;
+static uLong stream_crc;
+static uLong stream_len;
+static unsigned long long compressed_size;
+static int workers_stop;
+static pthread_t *workers;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+static void _write_stdout(const void *data, size_t len)
+{
+    if(len && fwrite(data, len, 1, stdout) != 1) die("write failed");
+}
+
+static void _compress_chunk(struct chunk *c)
+{
+    z_stream zs;
+    int ret;
+
+    memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, compress_level, Z_DEFLATED, -15, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK) {
+        die("deflateInit2 failed");
+    }
+    if(c->dict_len &&
+       deflateSetDictionary(&zs, c->dict, c->dict_len) != Z_OK) {
+        die("deflateSetDictionary failed");
+    }
+
+    /* room for the sync flush marker on top of the worst case */
+    size_t need = deflateBound(&zs, c->in_len) + 16;
+    if(c->out_size < need) {
+        free(c->out);
+        c->out = malloc(need);
+        if(c->out == NULL) die("cannot allocate %zu bytes", need);
+        c->out_size = need;
+    }
+
+    zs.next_in = c->in;
+    zs.avail_in = c->in_len;
+    zs.next_out = c->out;
+    zs.avail_out = c->out_size;
+    ret = deflate(&zs, c->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if(ret != (c->last ? Z_STREAM_END : Z_OK) || zs.avail_in != 0) {
+        die("deflate failed (%d)", ret);
+    }
+    c->out_len = c->out_size - zs.avail_out;
+    c->crc = crc32(0L, c->in, c->in_len);
+    deflateEnd(&zs);
+}
+
+static void *_compress_worker(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&ring_lock);
+    for(;;) {
+        while(next_job == next_fill && !workers_stop) {
+            pthread_cond_wait(&job_cond, &ring_lock);
+        }
+        if(next_job == next_fill) break;
+
+        struct chunk *c = &ring[next_job++ % ring_size];
+        pthread_mutex_unlock(&ring_lock);
+
+        _compress_chunk(c);
+
+        pthread_mutex_lock(&ring_lock);
+        c->state = CHUNK_DONE;
+        pthread_cond_broadcast(&done_cond);
+    }
+    pthread_mutex_unlock(&ring_lock);
+    return NULL;
+}
+
+/* Writes out the oldest outstanding chunk, waiting for it if needed. */
+static void _write_chunk()
+{
+    struct chunk *c = &ring[next_write % ring_size];
+
+    pthread_mutex_lock(&ring_lock);
+    while(c->state != CHUNK_DONE) {
+        pthread_cond_wait(&done_cond, &ring_lock);
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    _write_stdout(c->out, c->out_len);
+    compressed_size += c->out_len;
+    stream_crc = crc32_combine(stream_crc, c->crc, c->in_len);
+    stream_len += c->in_len;
+
+    c->state = CHUNK_FREE;
+    next_write++;
+}
+
+static void _submit_chunk(int last)
+{
+    struct chunk *c = &ring[next_fill % ring_size];
+
+    c->last = last;
+    memcpy(c->dict, tail, tail_len);
+    c->dict_len = tail_len;
+
+    tail_len = c->in_len < DICT_SIZE ? c->in_len : DICT_SIZE;
+    memcpy(tail, c->in + c->in_len - tail_len, tail_len);
+
+    if(compress_threads <= 1) {
+        _compress_chunk(c);
+        c->state = CHUNK_DONE;
+        next_fill++;
+    } else {
+        pthread_mutex_lock(&ring_lock);
+        c->state = CHUNK_QUEUED;
+        next_fill++;
+        pthread_cond_signal(&job_cond);
+        pthread_mutex_unlock(&ring_lock);
+    }
+
+    /* make sure the slot we are about to fill has been written */
+    c = &ring[next_fill % ring_size];
+    while(c->state != CHUNK_FREE) {
+        _write_chunk();
+    }
+    c->in_len = 0;
+}
+
+static void out_write(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    if(!compress_output) {
+        _write_stdout(data, len);
+        return;
+    }
+
+    while(len) {
+        struct chunk *c = &ring[next_fill % ring_size];
+        size_t n = CHUNK_SIZE - c->in_len;
+        if(n > len) n = len;
+
+        memcpy(c->in + c->in_len, p, n);
+        c->in_len += n;
+        p += n;
+        len -= n;
+
+        if(c->in_len == CHUNK_SIZE) _submit_chunk(0);
+    }
+}
+
+static void compress_begin()
+{
+    /* no name, no mtime: the header never changes between builds */
+    static const unsigned char gzip_header[10] = {
+        0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3 /* OS_CODE unix */
+    };
+    unsigned i;
+
+    if(compress_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        compress_threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if(compress_threads > MAX_THREADS) compress_threads = MAX_THREADS;
+
+    ring_size = compress_threads * 2;
+    ring = calloc(ring_size, sizeof(*ring));
+    if(ring == NULL) die("cannot allocate chunk ring");
+    for(i = 0; i < ring_size; i++) {
+        ring[i].in = malloc(CHUNK_SIZE);
+        if(ring[i].in == NULL) die("cannot allocate %d bytes", CHUNK_SIZE);
+    }
+    stream_crc = crc32(0L, Z_NULL, 0);
+
+    if(compress_threads > 1) {
+        workers = calloc(compress_threads, sizeof(*workers));
+        if(workers == NULL) die("cannot allocate worker threads");
+        for(i = 0; i < (unsigned)compress_threads; i++) {
+            if(pthread_create(&workers[i], NULL, _compress_worker, NULL)) {
+                die("cannot create compression thread");
+            }
+        }
+    }
+
+    _write_stdout(gzip_header, sizeof(gzip_header));
+    compressed_size = sizeof(gzip_header);
+}
+
+static void compress_end()
+{
+    unsigned char trailer[8];
+    unsigned i;
+
+    _submit_chunk(1);
+    while(next_write < next_fill) {
+        _write_chunk();
+    }
+
+    for(i = 0; i < 4; i++) {
+        trailer[i] = (unsigned char)(stream_crc >> (8 * i));
+        trailer[i + 4] = (unsigned char)(stream_len >> (8 * i));
+    }
+    _write_stdout(trailer, sizeof(trailer));
+    compressed_size += sizeof(trailer);
+
+    if(workers) {
+        pthread_mutex_lock(&ring_lock);
+        workers_stop = 1;
+        pthread_cond_broadcast(&job_cond);
+        pthread_mutex_unlock(&ring_lock);
+        for(i = 0; i < (unsigned)compress_threads; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        free(workers);
+    }
+    for(i = 0; i < ring_size; i++) {
+        free(ring[i].in);
+        free(ring[i].out);
+    }
+    free(ring);
+}
+
+static double now_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 static void read_canned_config(char* filename)
 {
     int allocated = 8;
@@ -325,25 +606,66 @@ static void read_canned_config(char* filename)
 }
 
 
+static void usage()
+{
+    fprintf(stderr,
+            "usage: mkbootfs [-d TARGET_OUTPUT_PATH] [-f CANNED_CONFIGURATION_PATH]\n"
+            "                [-z] [-l LEVEL] [-j THREADS] [-t] DIR[=PREFIX]...\n"
+            "\n"
+            "  -z          gzip the archive (parallel, output independent of -j)\n"
+            "  -l LEVEL    compression level for -z (0-9)\n"
+            "  -j THREADS  compression threads for -z (default: online cpus)\n"
+            "  -t          report timing and sizes on stderr\n");
+    exit(1);
+}
+
 int main(int argc, char *argv[])
 {
+    int timing = 0;
+    double start;
+
     argc--;
     argv++;
 
-    if (argc > 1 && strcmp(argv[0], "-d") == 0) {
-        target_out_path = argv[1];
-        argc -= 2;
-        argv += 2;
-    }
-
-    if (argc > 1 && strcmp(argv[0], "-f") == 0) {
-        read_canned_config(argv[1]);
-        argc -= 2;
-        argv += 2;
+    while (argc > 0 && argv[0][0] == '-') {
+        if (argc > 1 && strcmp(argv[0], "-d") == 0) {
+            target_out_path = argv[1];
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 1 && strcmp(argv[0], "-f") == 0) {
+            read_canned_config(argv[1]);
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 1 && strcmp(argv[0], "-l") == 0) {
+            compress_level = atoi(argv[1]);
+            if (compress_level < 0 || compress_level > 9) usage();
+            argc -= 2;
+            argv += 2;
+        } else if (argc > 1 && strcmp(argv[0], "-j") == 0) {
+            compress_threads = atoi(argv[1]);
+            if (compress_threads < 1) usage();
+            argc -= 2;
+            argv += 2;
+        } else if (strcmp(argv[0], "-z") == 0) {
+            compress_output = 1;
+            argc--;
+            argv++;
+        } else if (strcmp(argv[0], "-t") == 0) {
+            timing = 1;
+            argc--;
+            argv++;
+        } else if (strcmp(argv[0], "-h") == 0) {
+            usage();
+        } else {
+            break;
+        }
     }
 
     if(argc == 0) die("no directories to process?!");
 
+    start = now_seconds();
+    if(compress_output) compress_begin();
+
     while(argc-- > 0){
         char *x = strchr(*argv, '=');
         if(x != 0) {
@@ -359,5 +681,17 @@ int main(int argc, char *argv[])
 
     _eject_trailer();
 
+    if(compress_output) compress_end();
+    if(fflush(stdout)) die("write failed");
+
+    if(timing) {
+        fprintf(stderr, "mkbootfs: %d bytes", total_size);
+        if(compress_output) {
+            fprintf(stderr, " -> %llu gzipped (%d threads)",
+                    compressed_size, compress_threads);
+        }
+        fprintf(stderr, " in %.3fs\n", now_seconds() - start);
+    }
+
     return 0;
 }
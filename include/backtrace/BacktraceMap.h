@@ -30,7 +30,10 @@
 #endif
 
 #include <deque>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct backtrace_map_t {
@@ -87,6 +90,17 @@ public:
 
   virtual bool Build();
 
+  // Remember the function names looked up by the Backtrace objects sharing
+  // this map, so that unwinding many threads against it symbolizes every pc
+  // only once. The cache only grows and lives as long as the map, so it is
+  // meant for short lived maps, such as one built to dump all the threads of
+  // a process.
+  void EnableFunctionNameCache() { cache_function_names_ = true; }
+
+  // Returns false if the cache is disabled or has no entry for pc.
+  bool GetCachedFunctionName(uintptr_t pc, std::string* name, uintptr_t* offset);
+  void CacheFunctionName(uintptr_t pc, const std::string& name, uintptr_t offset);
+
   static inline bool IsValid(const backtrace_map_t& map) {
     return map.end > 0;
   }
@@ -106,6 +120,11 @@ protected:
 
   std::deque<backtrace_map_t> maps_;
   pid_t pid_;
+
+private:
+  bool cache_function_names_ = false;
+  std::mutex function_names_lock_;
+  std::unordered_map<uintptr_t, std::pair<std::string, uintptr_t>> function_names_;
 };
 
 class ScopedBacktraceMapIteratorLock {
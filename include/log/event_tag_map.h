@@ -23,6 +23,13 @@ extern "C" {
 
 #define EVENT_TAG_MAP_FILE  "/system/etc/event-log-tags"
 
+/*
+ * Suffix of the binary index of a map file. When the index exists and was
+ * made from the current contents of the map file it is mapped and probed in
+ * place of parsing. The build generates one next to EVENT_TAG_MAP_FILE.
+ */
+#define EVENT_TAG_MAP_INDEX_SUFFIX ".idx"
+
 struct EventTagMap;
 typedef struct EventTagMap EventTagMap;
 
@@ -43,6 +50,15 @@ void android_closeEventTagMap(EventTagMap* map);
  */
 const char* android_lookupEventTag(const EventTagMap* map, int tag);
 
+/*
+ * Write a binary index of the map file to the specified file, normally the
+ * map file name with EVENT_TAG_MAP_INDEX_SUFFIX appended.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int android_writeEventTagMapIndex(const char* mapFileName,
+                                  const char* indexFileName);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_LOG_EVENT_ENCODER_H
+#define _LIBS_LOG_EVENT_ENCODER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include <log/log.h>
+#include <log/logger.h>
+
+namespace android {
+
+/*
+ * Serializes events whose schema is known at compile time, without the
+ * per-element type dispatch and bounds checks of an android_log_context:
+ *
+ *   typedef android::EventEncoder<int32_t, int64_t, const char *> MyEvent;
+ *   MyEvent::write(MY_EVENT_TAG, uid, elapsed, name);
+ *
+ * A payload that fits is byte for byte what android_log_write_list()
+ * produces for the same values: a single field is logged bare, several are
+ * wrapped in a list. Supported fields are int32_t, int64_t, float, const char * and
+ * std::string; nested lists are not. Strings are truncated so that the
+ * whole event fits in a log entry, as android_log_write_string8() does.
+ */
+
+namespace event_encoder {
+
+// Largest event payload, the entry also carries the 4 byte tag
+static const size_t kMaxPayload = LOGGER_ENTRY_MAX_PAYLOAD - sizeof(int32_t);
+
+template <typename T> struct Field;
+
+template <typename T, AndroidEventLogType Type> struct ScalarField {
+    typedef T arg_type;
+    static const bool kVariable = false;
+    static const size_t kSize = sizeof(uint8_t) + sizeof(T);
+
+    static uint8_t *put(uint8_t *p, size_t & /* budget */, T value) {
+        *p = Type;
+        // Event payloads are little endian, as is every Android ABI
+        memcpy(p + sizeof(uint8_t), &value, sizeof(value));
+        return p + kSize;
+    }
+};
+
+template <> struct Field<int32_t> : ScalarField<int32_t, EVENT_TYPE_INT> {};
+template <> struct Field<int64_t> : ScalarField<int64_t, EVENT_TYPE_LONG> {};
+template <> struct Field<float> : ScalarField<float, EVENT_TYPE_FLOAT> {};
+
+struct StringField {
+    static const bool kVariable = true;
+    // Only the type and length are fixed, the characters come out of budget
+    static const size_t kSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+    static uint8_t *put(uint8_t *p, size_t &budget, const char *value,
+                        size_t len) {
+        if (len > budget) {
+            len = budget;
+        }
+        budget -= len;
+
+        uint32_t len32 = len;
+        *p = EVENT_TYPE_STRING;
+        memcpy(p + sizeof(uint8_t), &len32, sizeof(len32));
+        memcpy(p + kSize, value, len);
+        return p + kSize + len;
+    }
+};
+
+template <> struct Field<const char *> : StringField {
+    typedef const char *arg_type;
+
+    static uint8_t *put(uint8_t *p, size_t &budget, const char *value) {
+        if (!value) {
+            value = "";
+        }
+        return StringField::put(p, budget, value, strlen(value));
+    }
+};
+
+template <> struct Field<std::string> : StringField {
+    typedef const std::string &arg_type;
+
+    static uint8_t *put(uint8_t *p, size_t &budget, const std::string &value) {
+        return StringField::put(p, budget, value.data(), value.size());
+    }
+};
+
+// Compile time sum of the fixed sizes, and whether any field is a string
+template <typename... Fields> struct Schema;
+
+template <> struct Schema<> {
+    static const size_t kFixedSize = 0;
+    static const bool kVariable = false;
+};
+
+template <typename First, typename... Rest> struct Schema<First, Rest...> {
+    static const size_t kFixedSize =
+        Field<First>::kSize + Schema<Rest...>::kFixedSize;
+    static const bool kVariable =
+        Field<First>::kVariable || Schema<Rest...>::kVariable;
+};
+
+}  // namespace event_encoder
+
+template <typename... Fields>
+class EventEncoder {
+    typedef event_encoder::Schema<Fields...> Schema;
+
+    static const bool kIsList = sizeof...(Fields) > 1;
+    static const size_t kHeaderSize =
+        kIsList ? sizeof(uint8_t) + sizeof(uint8_t) : 0;
+    static const size_t kFixedSize = kHeaderSize + Schema::kFixedSize;
+
+    static_assert(sizeof...(Fields) > 0, "an event needs at least one field");
+    static_assert(sizeof...(Fields) <= UINT8_MAX, "too many fields for a list");
+    static_assert(kFixedSize <= event_encoder::kMaxPayload,
+                  "event does not fit in a log entry");
+
+public:
+    // Size of the buffer encode() needs, exact when there are no strings
+    static const size_t kMaxSize =
+        Schema::kVariable ? event_encoder::kMaxPayload : kFixedSize;
+
+    // Serializes values into buf, which must hold kMaxSize bytes.
+    // Returns the length of the payload.
+    static size_t encode(uint8_t *buf,
+            typename event_encoder::Field<Fields>::arg_type... values) {
+        uint8_t *p = buf;
+        size_t budget = kMaxSize - kFixedSize;
+
+        if (kIsList) {
+            *p++ = EVENT_TYPE_LIST;
+            *p++ = sizeof...(Fields);
+        }
+        // Braced initializers are evaluated in order, so are the fields
+        int unused[] = {
+            (p = event_encoder::Field<Fields>::put(p, budget, values), 0)...
+        };
+        (void) unused;
+
+        return p - buf;
+    }
+
+    static int write(uint32_t tag,
+            typename event_encoder::Field<Fields>::arg_type... values) {
+        uint8_t buf[kMaxSize];
+        size_t len = encode(buf, values...);
+        return __android_log_bwrite(tag, buf, len);
+    }
+
+    static int writeSecurity(uint32_t tag,
+            typename event_encoder::Field<Fields>::arg_type... values) {
+        uint8_t buf[kMaxSize];
+        size_t len = encode(buf, values...);
+        return __android_log_security_bwrite(tag, buf, len);
+    }
+};
+
+template <typename... Fields>
+const size_t EventEncoder<Fields...>::kMaxSize;
+
+}  // namespace android
+
+#endif /* _LIBS_LOG_EVENT_ENCODER_H */
@@ -49,6 +49,7 @@ struct usb_request
     void *private_data; /* struct usbdevfs_urb* */
     int endpoint;
     void *client_data;  /* free for use by client */
+    int status;         /* completion status, 0 or negative errno */
 };
 
 /* Callback for notification when new USB devices are attached.
@@ -237,6 +238,26 @@ int usb_request_queue(struct usb_request *req);
   */
 struct usb_request *usb_request_wait(struct usb_device *dev);
 
+/* Returns a completed request without blocking.
+ * Returns NULL with errno set to EAGAIN if nothing has completed yet.
+ */
+struct usb_request *usb_request_reap(struct usb_device *dev);
+
+/* Reaps up to count completed requests into reqs without blocking.
+ * Returns the number reaped (0 if none are ready), or -1 for error.
+ */
+int usb_request_reap_all(struct usb_device *dev, struct usb_request **reqs, int count);
+
+/* Returns a file descriptor that polls writable (POLLOUT / EPOLLOUT) while
+ * completed requests are waiting to be reaped.  Add it to an epoll set or
+ * Looper to drive many queued requests, across endpoints, without blocking
+ * in usb_request_wait().
+ */
+int usb_device_get_completion_fd(struct usb_device *dev);
+
+/* Returns the number of queued requests that have not been reaped yet. */
+int usb_device_get_pending_requests(struct usb_device *dev);
+
 /* Cancels a pending usb_request_queue() operation. */
 int usb_request_cancel(struct usb_request *req);
 
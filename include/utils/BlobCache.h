@@ -19,9 +19,12 @@
 
 #include <stddef.h>
 
+#include <memory>
+#include <unordered_map>
+
 #include <utils/Flattenable.h>
 #include <utils/RefBase.h>
-#include <utils/SortedVector.h>
+#include <utils/TypeHelpers.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -29,6 +32,9 @@ namespace android {
 // A BlobCache is an in-memory cache for binary key/value pairs.  A BlobCache
 // does NOT provide any thread-safety guarantees.
 //
+// Entries are indexed by a hash of their key.  When the cache fills up, the
+// least recently used entries are evicted first.
+//
 // The cache contents can be serialized to an in-memory buffer or mmap'd file
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
@@ -87,7 +93,9 @@ public:
     // flatten serializes the current contents of the cache into the memory
     // pointed to by 'buffer'.  The serialized cache contents can later be
     // loaded into a BlobCache object using the unflatten method.  The contents
-    // of the BlobCache object will not be modified.
+    // of the BlobCache object will not be modified.  Entries are written from
+    // the least to the most recently used, so that unflattening them keeps
+    // their eviction order.
     //
     // Preconditions:
     //   size >= this.getFlattenedSize()
@@ -101,15 +109,26 @@ public:
     //
     status_t unflatten(void const* buffer, size_t size);
 
+    // unflattenInPlace is the same as unflatten, except that the loaded keys
+    // and values point into 'buffer' rather than being copied out of it, so
+    // that a cache file can be mmap'd and used without reading all of it.
+    // The buffer must stay mapped and unmodified until the cache is destroyed
+    // or unflattened again.  Values set afterwards are copied as usual.
+    status_t unflattenInPlace(void const* buffer, size_t size);
+
 private:
     // Copying is disallowed.
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
+    // set and both unflatten methods share this, copyData tells whether the
+    // key and value are copied or referenced.
+    void set(const void* key, size_t keySize, const void* value,
+            size_t valueSize, bool copyData);
+
+    status_t unflatten(void const* buffer, size_t size, bool copyData);
 
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -123,8 +142,6 @@ private:
         Blob(const void* data, size_t size, bool copyData);
         ~Blob();
 
-        bool operator<(const Blob& rhs) const;
-
         const void* getData() const;
         size_t getSize() const;
 
@@ -144,22 +161,25 @@ private:
         bool mOwnsData;
     };
 
-    // A CacheEntry is a single key/value pair in the cache.
+    // A CacheEntry is a single key/value pair in the cache.  Entries are
+    // linked together from the least to the most recently used.
     class CacheEntry {
     public:
-        CacheEntry();
         CacheEntry(const sp<Blob>& key, const sp<Blob>& value);
-        CacheEntry(const CacheEntry& ce);
-
-        bool operator<(const CacheEntry& rhs) const;
-        const CacheEntry& operator=(const CacheEntry&);
 
         sp<Blob> getKey() const;
         sp<Blob> getValue() const;
 
         void setValue(const sp<Blob>& value);
 
+        // mOlder and mYounger are the neighbours of the entry in the LRU list.
+        CacheEntry* mOlder;
+        CacheEntry* mYounger;
+
     private:
+        // Copying is not allowed.
+        CacheEntry(const CacheEntry&);
+        void operator=(const CacheEntry&);
 
         // mKey is the key that identifies the cache entry.
         sp<Blob> mKey;
@@ -168,6 +188,35 @@ private:
         sp<Blob> mValue;
     };
 
+    // A KeyRef indexes a cache entry by its key.  It points to the key data
+    // without owning it, either the key of the entry or the key being looked
+    // up, and caches its hash.
+    struct KeyRef {
+        KeyRef(const void* data, size_t size);
+
+        bool operator==(const KeyRef& rhs) const;
+
+        const void* mData;
+        size_t mSize;
+        hash_t mHash;
+    };
+
+    struct KeyRefHash {
+        size_t operator()(const KeyRef& key) const { return key.mHash; }
+    };
+
+    typedef std::unordered_map<KeyRef, std::unique_ptr<CacheEntry>, KeyRefHash>
+            CacheEntryMap;
+
+    // attach makes entry the most recently used, detach unlinks it from the
+    // LRU list.
+    void attach(CacheEntry* entry);
+    void detach(CacheEntry* entry);
+
+    // remove evicts the entry at 'it' from the cache, clear evicts them all.
+    void remove(CacheEntryMap::iterator it);
+    void clear();
+
     // A Header is the header for the entire BlobCache serialization format. No
     // need to make this portable, so we simply write the struct out.
     struct Header {
@@ -235,13 +284,14 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCacheEntries stores all the cache entries that are resident in memory,
+    // indexed by key.  Cache entries are added to it by the 'set' method.
+    CacheEntryMap mCacheEntries;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    SortedVector<CacheEntry> mCacheEntries;
+    // mOldest and mYoungest are the ends of the LRU list of the entries in
+    // mCacheEntries.  clean evicts entries starting from mOldest.
+    CacheEntry* mOldest;
+    CacheEntry* mYoungest;
 };
 
 }
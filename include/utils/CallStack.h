@@ -25,6 +25,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+class BacktraceMap;
+
 namespace android {
 
 class Printer;
@@ -44,7 +46,10 @@ public:
 
     // Immediately collect the stack traces for the specified thread.
     // The default is to dump the stack of the current call.
-    void update(int32_t ignoreDepth=1, pid_t tid=BACKTRACE_CURRENT_THREAD);
+    // When unwinding several threads in a row, pass the same map to all
+    // the calls rather than letting each of them read the process's maps.
+    void update(int32_t ignoreDepth=1, pid_t tid=BACKTRACE_CURRENT_THREAD,
+                BacktraceMap* map=NULL);
 
     // Dump a stack trace to the log using the supplied logtag.
     void log(const char* logtag,
@@ -85,6 +85,8 @@ public:
             ssize_t         add(const KEY& key, const VALUE& item);
             ssize_t         replaceValueFor(const KEY& key, const VALUE& item);
             ssize_t         replaceValueAt(size_t index, const VALUE& item);
+            //! same as add()ing each pair, in order, but O(n log n)
+            ssize_t         add(const Vector< key_value_pair_t<KEY, VALUE> >& items);
 
     /*!
      * remove items
@@ -177,6 +179,11 @@ ssize_t KeyedVector<KEY,VALUE>::add(const KEY& key, const VALUE& value) {
     return mVector.add( key_value_pair_t<KEY,VALUE>(key, value) );
 }
 
+template<typename KEY, typename VALUE> inline
+ssize_t KeyedVector<KEY,VALUE>::add(const Vector< key_value_pair_t<KEY, VALUE> >& items) {
+    return mVector.merge(items);
+}
+
 template<typename KEY, typename VALUE> inline
 ssize_t KeyedVector<KEY,VALUE>::replaceValueFor(const KEY& key, const VALUE& value) {
     key_value_pair_t<KEY,VALUE> pair(key, value);
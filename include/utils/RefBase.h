@@ -127,6 +127,19 @@ public:
 protected:
                             RefBase();
     virtual                 ~RefBase();
+
+    //! Flags for RefBase(uint32_t)
+    enum {
+        // Don't allocate the weak reference bookkeeping until the first
+        // createWeak(), getWeakRefs() or extendObjectLifetime(). Until then
+        // the strong count lives in the object and incStrong()/decStrong()
+        // are a single atomic operation, so objects that are only ever held
+        // by sp<> cost one allocation instead of two. With virtual
+        // inheritance the most derived class has to pass it.
+        REFS_LAZY = 0x0001
+    };
+
+    explicit                RefBase(uint32_t flags);
     
     //! Flags for extendObjectLifetime()
     enum {
@@ -150,6 +163,8 @@ protected:
 private:
     friend class weakref_type;
     class weakref_impl;
+
+            weakref_impl*   getRefs() const;
     
                             RefBase(const RefBase& o);
             RefBase&        operator=(const RefBase& o);
@@ -165,7 +180,9 @@ private:
     static void renameRefId(RefBase* ref,
             const void* old_id, const void* new_id);
 
-        weakref_impl* const mRefs;
+        // The weakref_impl, or for REFS_LAZY objects that have not needed
+        // one yet the tagged strong count. Same size as a pointer.
+        mutable std::atomic<intptr_t> mRefs;
 };
 
 // ---------------------------------------------------------------------------
@@ -114,6 +114,8 @@ public:
             //! merges a vector into this one
             ssize_t         merge(const Vector<TYPE>& vector);
             ssize_t         merge(const SortedVector<TYPE>& vector);
+            //! same as add()ing each item of array, in order, but O(n log n)
+            ssize_t         merge(const TYPE* array, size_t length);
             
             //! removes an item
             ssize_t         remove(const TYPE&);
@@ -227,6 +229,11 @@ ssize_t SortedVector<TYPE>::merge(const SortedVector<TYPE>& vector) {
     return SortedVectorImpl::merge(reinterpret_cast<const SortedVectorImpl&>(vector));
 }
 
+template<class TYPE> inline
+ssize_t SortedVector<TYPE>::merge(const TYPE* array, size_t length) {
+    return SortedVectorImpl::merge(array, length);
+}
+
 template<class TYPE> inline
 ssize_t SortedVector<TYPE>::remove(const TYPE& item) {
     return SortedVectorImpl::remove(&item);
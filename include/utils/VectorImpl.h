@@ -99,6 +99,10 @@ protected:
             size_t          itemSize() const;
             void            release_storage();
 
+            /*! replaces the content with copies of items[0..count), which
+             *  may point into this vector */
+            status_t        rebuild(const void* const* items, size_t count);
+
     virtual void            do_construct(void* storage, size_t num) const = 0;
     virtual void            do_destroy(void* storage, size_t num) const = 0;
     virtual void            do_copy(void* dest, const void* from, size_t num) const = 0;
@@ -149,6 +153,7 @@ public:
     //! merges a vector into this one
             ssize_t         merge(const VectorImpl& vector);
             ssize_t         merge(const SortedVectorImpl& vector);
+            ssize_t         merge(const void* array, size_t length);
              
     //! removes an item
             ssize_t         remove(const void* item);
@@ -44,6 +44,13 @@
  *   writer.StartEntry("empty.txt", 0);
  *   writer.FinishEntry();
  *
+ *   // Compress the remaining entries quickly, on 4 threads.
+ *   writer.SetCompressionLevel(1);
+ *   writer.SetCompressionThreads(4);
+ *   writer.StartEntry("large.bin", ZipWriter::kCompress);
+ *   writer.WriteBytes(largeBuffer, largeBufferLen);
+ *   writer.FinishEntry();
+ *
  *   writer.Finish();
  *
  *   fclose(file);
@@ -78,6 +85,26 @@ public:
   // Move assignment.
   ZipWriter& operator=(ZipWriter&& zipWriter);
 
+  ~ZipWriter();
+
+  /**
+   * Sets the deflate level, from Z_NO_COMPRESSION (0) to Z_BEST_COMPRESSION (9), of the
+   * compressed entries started after this call, so each entry can trade size for speed.
+   * The default is Z_BEST_COMPRESSION.
+   * Returns 0 on success, and an error value < 0 if the level is out of range.
+   */
+  int32_t SetCompressionLevel(int level);
+
+  /**
+   * Compresses the entries started after this call on up to the given number of threads.
+   * The data of each compressed entry is split into chunks that are deflated concurrently,
+   * each primed with the end of the previous chunk, and joined into a single deflate stream
+   * that any zip reader can inflate. The output is a little larger than with one thread,
+   * but does not depend on the number of threads.
+   * The default is 1, which compresses on the calling thread. Windows always uses 1.
+   */
+  void SetCompressionThreads(size_t threads);
+
   /**
    * Starts a new zip entry with the given path and flags.
    * Flags can be a bitwise OR of ZipWriter::kCompress and ZipWriter::kAlign.
@@ -147,6 +174,14 @@ private:
   int32_t CompressBytes(FileInfo* file, const void* data, size_t len);
   int32_t FlushCompressedBytes(FileInfo* file);
 
+  // Chunked deflate, used when compressing on several threads.
+  struct DeflatedChunk;
+  struct ParallelDeflate;
+  static DeflatedChunk DeflateChunk(std::vector<uint8_t> input, std::vector<uint8_t> dictionary,
+                                    int level, bool last);
+  int32_t QueueChunk(FileInfo* file, bool last);
+  int32_t WriteChunk(FileInfo* file, const DeflatedChunk& chunk);
+
   enum class State {
     kWritingZip,
     kWritingEntry,
@@ -159,8 +194,14 @@ private:
   State state_;
   std::vector<FileInfo> files_;
 
+  int compression_level_;
+  size_t compression_threads_;
+
   std::unique_ptr<z_stream, void(*)(z_stream*)> z_stream_;
   std::vector<uint8_t> buffer_;
+
+  // Set instead of z_stream_ while a compressed entry is written on several threads.
+  std::unique_ptr<ParallelDeflate> parallel_;
 };
 
 #endif /* LIBZIPARCHIVE_ZIPWRITER_H_ */
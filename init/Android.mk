@@ -49,6 +49,7 @@ LOCAL_SRC_FILES:= \
     init_parser.cpp \
     log.cpp \
     parser.cpp \
+    perm_matcher.cpp \
     service.cpp \
     util.cpp \
 
@@ -121,6 +122,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := init_tests
 LOCAL_SRC_FILES := \
     init_parser_test.cpp \
+    perm_matcher_test.cpp \
     util_test.cpp \
 
 LOCAL_SHARED_LIBRARIES += \
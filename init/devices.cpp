@@ -37,10 +37,22 @@
 #include <selinux/avc.h>
 
 #include <private/android_filesystem_config.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include <android-base/file.h>
+#include <android-base/stringprintf.h>
 #include <cutils/list.h>
 #include <cutils/probe_module.h>
 #include <cutils/uevent.h>
@@ -50,6 +62,7 @@
 #include "util.h"
 #include "log.h"
 #include "parser.h"
+#include "perm_matcher.h"
 
 #define SYSFS_PREFIX    "/sys"
 #if defined(__i386__) || defined(__x86_64__)
@@ -91,11 +104,6 @@ struct perms_ {
     unsigned short wildcard;
 };
 
-struct perm_node {
-    struct perms_ dp;
-    struct listnode plist;
-};
-
 struct platform_node {
     char *name;
     char *path;
@@ -115,8 +123,11 @@ struct module_blacklist_node {
     struct listnode list;
 };
 
-static list_declare(sys_perms);
-static list_declare(dev_perms);
+/* Rules in ueventd.rc order; the matchers hand back indices into these. */
+static std::vector<struct perms_*> sys_perms;
+static std::vector<struct perms_*> dev_perms;
+static PermMatcher sys_perm_matcher;
+static PermMatcher dev_perm_matcher;
 static list_declare(platform_names);
 static list_declare(modules_aliases_map);
 static list_declare(modules_blacklist);
@@ -129,30 +140,34 @@ int add_dev_perms(const char *name, const char *attr,
                   mode_t perm, unsigned int uid, unsigned int gid,
                   unsigned short prefix,
                   unsigned short wildcard) {
-    struct perm_node *node = (perm_node*) calloc(1, sizeof(*node));
-    if (!node)
+    struct perms_ *dp = (perms_*) calloc(1, sizeof(*dp));
+    if (!dp)
         return -ENOMEM;
 
-    node->dp.name = strdup(name);
-    if (!node->dp.name)
+    dp->name = strdup(name);
+    if (!dp->name)
         return -ENOMEM;
 
     if (attr) {
-        node->dp.attr = strdup(attr);
-        if (!node->dp.attr)
+        dp->attr = strdup(attr);
+        if (!dp->attr)
             return -ENOMEM;
     }
 
-    node->dp.perm = perm;
-    node->dp.uid = uid;
-    node->dp.gid = gid;
-    node->dp.prefix = prefix;
-    node->dp.wildcard = wildcard;
+    dp->perm = perm;
+    dp->uid = uid;
+    dp->gid = gid;
+    dp->prefix = prefix;
+    dp->wildcard = wildcard;
 
-    if (attr)
-        list_add_tail(&sys_perms, &node->plist);
-    else
-        list_add_tail(&dev_perms, &node->plist);
+    /* upaths omit the "/sys" that sys rules contain, so match on name + 4 */
+    if (attr) {
+        sys_perms.push_back(dp);
+        sys_perm_matcher.Add(dp->name + 4, prefix, wildcard);
+    } else {
+        dev_perms.push_back(dp);
+        dev_perm_matcher.Add(dp->name, prefix, wildcard);
+    }
 
     return 0;
 }
@@ -160,24 +175,10 @@ int add_dev_perms(const char *name, const char *attr,
 void fixup_sys_perms(const char *upath)
 {
     char buf[512];
-    struct listnode *node;
-    struct perms_ *dp;
 
-    /* upaths omit the "/sys" that paths in this list
-     * contain, so we add 4 when comparing...
-     */
-    list_for_each(node, &sys_perms) {
-        dp = &(node_to_item(node, struct perm_node, plist))->dp;
-        if (dp->prefix) {
-            if (strncmp(upath, dp->name + 4, strlen(dp->name + 4)))
-                continue;
-        } else if (dp->wildcard) {
-            if (fnmatch(dp->name + 4, upath, FNM_PATHNAME) != 0)
-                continue;
-        } else {
-            if (strcmp(upath, dp->name + 4))
-                continue;
-        }
+    /* every matching rule is applied, in ueventd.rc order */
+    for (size_t index : sys_perm_matcher.FindAll(upath)) {
+        struct perms_ *dp = sys_perms[index];
 
         if ((strlen(upath) + strlen(dp->attr) + 6) > sizeof(buf))
             break;
@@ -200,57 +201,24 @@ void fixup_sys_perms(const char *upath)
     }
 }
 
-static bool perm_path_matches(const char *path, struct perms_ *dp)
-{
-    if (dp->prefix) {
-        if (strncmp(path, dp->name, strlen(dp->name)) == 0)
-            return true;
-    } else if (dp->wildcard) {
-        if (fnmatch(dp->name, path, FNM_PATHNAME) == 0)
-            return true;
-    } else {
-        if (strcmp(path, dp->name) == 0)
-            return true;
-    }
-
-    return false;
-}
-
 static mode_t get_device_perm(const char *path, const char **links,
                 unsigned *uid, unsigned *gid)
 {
-    struct listnode *node;
-    struct perm_node *perm_node;
-    struct perms_ *dp;
-
-    /* search the perms list in reverse so that ueventd.$hardware can
+    /* the last matching rule wins so that ueventd.$hardware can
      * override ueventd.rc
      */
-    list_for_each_reverse(node, &dev_perms) {
-        bool match = false;
-
-        perm_node = node_to_item(node, struct perm_node, plist);
-        dp = &perm_node->dp;
-
-        if (perm_path_matches(path, dp)) {
-            match = true;
-        } else {
-            if (links) {
-                int i;
-                for (i = 0; links[i]; i++) {
-                    if (perm_path_matches(links[i], dp)) {
-                        match = true;
-                        break;
-                    }
-                }
-            }
+    ssize_t match = dev_perm_matcher.FindLast(path);
+    if (links) {
+        for (int i = 0; links[i]; i++) {
+            match = std::max(match, dev_perm_matcher.FindLast(links[i]));
         }
+    }
 
-        if (match) {
-            *uid = dp->uid;
-            *gid = dp->gid;
-            return dp->perm;
-        }
+    if (match >= 0) {
+        struct perms_ *dp = dev_perms[match];
+        *uid = dp->uid;
+        *gid = dp->gid;
+        return dp->perm;
     }
     /* Default if nothing found. */
     *uid = 0;
@@ -967,35 +935,48 @@ static void handle_device_event(struct uevent *uevent)
     }
 }
 
+/* Copies the firmware image into the sysfs data file without bouncing
+ * it through a userspace buffer: sendfile() where the kernel allows it,
+ * otherwise straight out of a private mapping of the image.
+ */
+static int copy_firmware(int fw_fd, int data_fd, off_t size)
+{
+    off_t offset = 0;
+
+    while (offset < size) {
+        ssize_t nr = sendfile(data_fd, fw_fd, &offset, size - offset);
+        if (nr > 0)
+            continue;
+        if (nr < 0 && errno == EINTR)
+            continue;
+        if (nr == 0 || offset > 0 || (errno != EINVAL && errno != ENOSYS))
+            return -1;
+        break;  /* sysfs won't take sendfile() here, map it instead */
+    }
+    if (offset >= size)
+        return 0;
+
+    void *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fw_fd, 0);
+    if (image == MAP_FAILED)
+        return -1;
+    madvise(image, size, MADV_SEQUENTIAL);
+    bool ok = android::base::WriteFully(data_fd, image, size);
+    munmap(image, size);
+    return ok ? 0 : -1;
+}
+
 static int load_firmware(int fw_fd, int loading_fd, int data_fd)
 {
     struct stat st;
-    long len_to_copy;
     int ret = 0;
 
     if(fstat(fw_fd, &st) < 0)
         return -1;
-    len_to_copy = st.st_size;
 
     write(loading_fd, "1", 1);  /* start transfer */
 
-    while (len_to_copy > 0) {
-        char buf[PAGE_SIZE];
-        ssize_t nr;
-
-        nr = read(fw_fd, buf, sizeof(buf));
-        if(!nr)
-            break;
-        if(nr < 0) {
-            ret = -1;
-            break;
-        }
-        if (!android::base::WriteFully(data_fd, buf, nr)) {
-            ret = -1;
-            break;
-        }
-        len_to_copy -= nr;
-    }
+    if (st.st_size > 0)
+        ret = copy_firmware(fw_fd, data_fd, st.st_size);
 
     if(!ret)
         write(loading_fd, "0", 1);  /* successful end of transfer */
@@ -1005,17 +986,43 @@ static int load_firmware(int fw_fd, int loading_fd, int data_fd)
     return ret;
 }
 
-static void process_firmware_event(struct uevent *uevent)
+/* firmware name -> index into firmware_dirs where it was last found */
+static std::mutex firmware_dir_lock;
+static std::unordered_map<std::string, size_t> firmware_dir_cache;
+
+static int open_firmware(const char *firmware)
+{
+    size_t first = 0;
+    {
+        std::lock_guard<std::mutex> lock(firmware_dir_lock);
+        auto it = firmware_dir_cache.find(firmware);
+        if (it != firmware_dir_cache.end())
+            first = it->second;
+    }
+
+    /* try the cached directory first, then the rest in order */
+    for (size_t n = 0; n < ARRAY_SIZE(firmware_dirs); n++) {
+        size_t i = (n == 0) ? first : (n <= first ? n - 1 : n);
+        std::string file = android::base::StringPrintf("%s/%s", firmware_dirs[i], firmware);
+        int fw_fd = open(file.c_str(), O_RDONLY|O_CLOEXEC);
+        if (fw_fd >= 0) {
+            std::lock_guard<std::mutex> lock(firmware_dir_lock);
+            firmware_dir_cache[firmware] = i;
+            return fw_fd;
+        }
+    }
+    return -1;
+}
+
+static void process_firmware_event(const char *path, const char *firmware)
 {
     char *root, *loading, *data;
     int l, loading_fd, data_fd, fw_fd;
-    size_t i;
     int booting = is_booting();
 
-    NOTICE("firmware: loading '%s' for '%s'\n",
-         uevent->firmware, uevent->path);
+    NOTICE("firmware: loading '%s' for '%s'\n", firmware, path);
 
-    l = asprintf(&root, SYSFS_PREFIX"%s/", uevent->path);
+    l = asprintf(&root, SYSFS_PREFIX"%s/", path);
     if (l == -1)
         return;
 
@@ -1036,21 +1043,7 @@ static void process_firmware_event(struct uevent *uevent)
         goto loading_close_out;
 
 try_loading_again:
-    for (i = 0; i < ARRAY_SIZE(firmware_dirs); i++) {
-        char *file = NULL;
-        l = asprintf(&file, "%s/%s", firmware_dirs[i], uevent->firmware);
-        if (l == -1)
-            goto data_free_out;
-        fw_fd = open(file, O_RDONLY|O_CLOEXEC);
-        free(file);
-        if (fw_fd >= 0) {
-            if(!load_firmware(fw_fd, loading_fd, data_fd))
-                INFO("firmware: copy success { '%s', '%s' }\n", root, uevent->firmware);
-            else
-                INFO("firmware: copy failure { '%s', '%s' }\n", root, uevent->firmware);
-            break;
-        }
-    }
+    fw_fd = open_firmware(firmware);
     if (fw_fd < 0) {
         if (booting) {
             /* If we're not fully booted, we may be missing
@@ -1060,11 +1053,16 @@ try_loading_again:
             booting = is_booting();
             goto try_loading_again;
         }
-        INFO("firmware: could not open '%s': %s\n", uevent->firmware, strerror(errno));
+        INFO("firmware: could not open '%s': %s\n", firmware, strerror(errno));
         write(loading_fd, "-1", 2);
         goto data_close_out;
     }
 
+    if(!load_firmware(fw_fd, loading_fd, data_fd))
+        INFO("firmware: copy success { '%s', '%s' }\n", root, firmware);
+    else
+        INFO("firmware: copy failure { '%s', '%s' }\n", root, firmware);
+
     close(fw_fd);
 data_close_out:
     close(data_fd);
@@ -1078,6 +1076,36 @@ root_free_out:
     free(root);
 }
 
+/* Firmware requests are independent of each other, so a small pool of
+ * loader threads in the firmware child services several devices at once
+ * instead of making each wait for the previous image to finish copying.
+ */
+#define FIRMWARE_LOADER_THREADS 4
+
+static std::mutex firmware_queue_lock;
+static std::condition_variable firmware_queue_cv;
+static std::deque<std::pair<std::string, std::string>> firmware_queue;
+static size_t firmware_idle_loaders;
+static size_t firmware_loaders;
+
+static void firmware_loader()
+{
+    std::unique_lock<std::mutex> lock(firmware_queue_lock);
+    while (true) {
+        while (firmware_queue.empty()) {
+            firmware_idle_loaders++;
+            firmware_queue_cv.wait(lock);
+            firmware_idle_loaders--;
+        }
+        auto request = std::move(firmware_queue.front());
+        firmware_queue.pop_front();
+
+        lock.unlock();
+        process_firmware_event(request.first.c_str(), request.second.c_str());
+        lock.lock();
+    }
+}
+
 static void handle_firmware_event(struct uevent *uevent)
 {
     if(strcmp(uevent->subsystem, "firmware"))
@@ -1086,7 +1114,14 @@ static void handle_firmware_event(struct uevent *uevent)
     if(strcmp(uevent->action, "add"))
         return;
 
-    process_firmware_event(uevent);
+    std::lock_guard<std::mutex> lock(firmware_queue_lock);
+    firmware_queue.emplace_back(uevent->path, uevent->firmware);
+    if (firmware_idle_loaders < firmware_queue.size() &&
+        firmware_loaders < FIRMWARE_LOADER_THREADS) {
+        std::thread(firmware_loader).detach();
+        firmware_loaders++;
+    }
+    firmware_queue_cv.notify_one();
 }
 
 static void parse_line_module_alias(struct parse_state *state, int nargs, char **args)
@@ -51,7 +51,11 @@
 #include <cutils/sockets.h>
 #include <private/android_filesystem_config.h>
 
+#include <functional>
 #include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
 
 #include "action.h"
 #include "bootchart.h"
@@ -77,7 +81,18 @@ static char qemu[32];
 
 int have_console;
 std::string console_name = "/dev/console";
-static time_t process_needs_restart;
+// Services waiting out their restart delay, soonest first. Entries can go
+// stale (the service was started or removed meanwhile); they are dropped
+// when they come due.
+typedef std::pair<time_t, std::string> RestartTimer;
+static std::priority_queue<RestartTimer, std::vector<RestartTimer>,
+                           std::greater<RestartTimer>> restart_timers;
+
+// Bounds on how much of the action queue one pass of the main loop runs
+// before it goes back to epoll for property, signal and keychord events.
+#define MAX_COMMANDS_PER_BATCH  16
+#define COMMAND_BATCH_BUDGET    0.010   // seconds
+#define MAX_EPOLL_EVENTS        16
 
 const char *ENV[32];
 
@@ -132,13 +147,28 @@ void property_changed(const char *name, const char *value)
         ActionManager::GetInstance().QueuePropertyTrigger(name, value);
 }
 
+void schedule_service_restart(const std::string& name, time_t when)
+{
+    restart_timers.emplace(when, name);
+}
+
 static void restart_processes()
 {
-    process_needs_restart = 0;
-    ServiceManager::GetInstance().
-        ForEachServiceWithFlags(SVC_RESTARTING, [] (Service* s) {
-                s->RestartIfNeeded(process_needs_restart);
-            });
+    time_t now = gettime();
+    while (!restart_timers.empty() && restart_timers.top().first <= now) {
+        std::string name = restart_timers.top().second;
+        restart_timers.pop();
+
+        Service* svc = ServiceManager::GetInstance().FindServiceByName(name);
+        if (!svc || !(svc->flags() & SVC_RESTARTING)) {
+            continue;
+        }
+        time_t next_restart = 0;
+        svc->RestartIfNeeded(next_restart);
+        if (next_restart) {
+            schedule_service_restart(name, next_restart);
+        }
+    }
 }
 
 void handle_control_message(const std::string& msg, const std::string& name) {
@@ -756,13 +786,19 @@ int main(int argc, char** argv) {
 
     while (true) {
         if (!waiting_for_exec) {
-            am.ExecuteOneCommand();
+            Timer t;
+            for (int n = 0; n < MAX_COMMANDS_PER_BATCH && am.HasMoreCommands(); ++n) {
+                am.ExecuteOneCommand();
+                if (waiting_for_exec || t.duration() >= COMMAND_BATCH_BUDGET) {
+                    break;
+                }
+            }
             restart_processes();
         }
 
         int timeout = -1;
-        if (process_needs_restart) {
-            timeout = (process_needs_restart - gettime()) * 1000;
+        if (!restart_timers.empty()) {
+            timeout = (restart_timers.top().first - gettime()) * 1000;
             if (timeout < 0)
                 timeout = 0;
         }
@@ -773,12 +809,13 @@ int main(int argc, char** argv) {
 
         bootchart_sample(&timeout);
 
-        epoll_event ev;
-        int nr = TEMP_FAILURE_RETRY(epoll_wait(epoll_fd, &ev, 1, timeout));
+        epoll_event ev[MAX_EPOLL_EVENTS];
+        int nr = TEMP_FAILURE_RETRY(epoll_wait(epoll_fd, ev, MAX_EPOLL_EVENTS, timeout));
         if (nr == -1) {
             ERROR("epoll_wait failed: %s\n", strerror(errno));
-        } else if (nr == 1) {
-            ((void (*)()) ev.data.ptr)();
+        }
+        for (int i = 0; i < nr; ++i) {
+            ((void (*)()) ev[i].data.ptr)();
         }
     }
 
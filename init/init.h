@@ -17,6 +17,8 @@
 #ifndef _INIT_INIT_H
 #define _INIT_INIT_H
 
+#include <time.h>
+
 #include <string>
 
 class Action;
@@ -39,6 +41,11 @@ int selinux_reload_policy(void);
 
 void register_epoll_handler(int fd, void (*fn)());
 
+/* Has the main loop call RestartIfNeeded() on service |name| once |when| (in
+ * gettime() seconds) has passed.
+ */
+void schedule_service_restart(const std::string& name, time_t when);
+
 int add_environment(const char* key, const char* val);
 
 #endif  /* _INIT_INIT_H */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "perm_matcher.h"
+
+#include <fnmatch.h>
+#include <string.h>
+
+#include <algorithm>
+
+void PermMatcher::Add(const std::string& name, bool prefix, bool wildcard) {
+    size_t index = num_rules_++;
+
+    if (wildcard) {
+        // Everything up to the first special character has to match
+        // literally, so only paths that reach that node can match.
+        size_t literal = strcspn(name.c_str(), "*?[\\");
+        nodes_[NodeFor(name.c_str(), literal)].wildcard.emplace_back(index, name);
+    } else if (prefix) {
+        nodes_[NodeFor(name.c_str(), name.size())].prefix.push_back(index);
+    } else {
+        nodes_[NodeFor(name.c_str(), name.size())].exact.push_back(index);
+    }
+}
+
+void PermMatcher::Clear() {
+    nodes_.clear();
+    num_rules_ = 0;
+}
+
+size_t PermMatcher::NodeFor(const char* name, size_t len) {
+    if (nodes_.empty()) {
+        nodes_.emplace_back();
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        const Node* child = Child(nodes_[n], name[i]);
+        if (child) {
+            n = child - nodes_.data();
+            continue;
+        }
+        nodes_.emplace_back();
+        nodes_[n].children.emplace_back(name[i], nodes_.size() - 1);
+        n = nodes_.size() - 1;
+    }
+    return n;
+}
+
+const PermMatcher::Node* PermMatcher::Child(const Node& node, char c) const {
+    for (const auto& child : node.children) {
+        if (child.first == c) {
+            return &nodes_[child.second];
+        }
+    }
+    return nullptr;
+}
+
+ssize_t PermMatcher::FindLast(const char* path) const {
+    ssize_t best = -1;
+    if (nodes_.empty()) {
+        return best;
+    }
+
+    const Node* node = &nodes_[0];
+    for (const char* p = path; node; ++p) {
+        if (!node->prefix.empty()) {
+            best = std::max(best, static_cast<ssize_t>(node->prefix.back()));
+        }
+        // Newest first, and nothing older than what already matched.
+        for (auto it = node->wildcard.rbegin(); it != node->wildcard.rend(); ++it) {
+            if (static_cast<ssize_t>(it->first) <= best) break;
+            if (fnmatch(it->second.c_str(), path, FNM_PATHNAME) == 0) {
+                best = it->first;
+                break;
+            }
+        }
+        if (*p == '\0') {
+            if (!node->exact.empty()) {
+                best = std::max(best, static_cast<ssize_t>(node->exact.back()));
+            }
+            break;
+        }
+        node = Child(*node, *p);
+    }
+    return best;
+}
+
+std::vector<size_t> PermMatcher::FindAll(const char* path) const {
+    std::vector<size_t> matches;
+    if (nodes_.empty()) {
+        return matches;
+    }
+
+    const Node* node = &nodes_[0];
+    for (const char* p = path; node; ++p) {
+        matches.insert(matches.end(), node->prefix.begin(), node->prefix.end());
+        for (const auto& rule : node->wildcard) {
+            if (fnmatch(rule.second.c_str(), path, FNM_PATHNAME) == 0) {
+                matches.push_back(rule.first);
+            }
+        }
+        if (*p == '\0') {
+            matches.insert(matches.end(), node->exact.begin(), node->exact.end());
+            break;
+        }
+        node = Child(*node, *p);
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INIT_PERM_MATCHER_H
+#define _INIT_PERM_MATCHER_H
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+// Matches paths against the ueventd.rc permission rules. Rules are
+// numbered in the order they are added and keep the exact, prefix and
+// fnmatch(FNM_PATHNAME) semantics of the rule list, but are indexed in a
+// character trie: exact and prefix rules hang off the node for their name,
+// wildcard rules off the node for their literal leading part, so a lookup
+// is a single walk down the path instead of a scan over every rule.
+class PermMatcher {
+public:
+    void Add(const std::string& name, bool prefix, bool wildcard);
+    void Clear();
+    size_t size() const { return num_rules_; }
+
+    // Returns the index of the last added rule that matches |path|, or -1.
+    ssize_t FindLast(const char* path) const;
+
+    // Returns the indices of every rule that matches |path|, in the order
+    // the rules were added.
+    std::vector<size_t> FindAll(const char* path) const;
+
+private:
+    struct Node {
+        std::vector<std::pair<char, size_t>> children;
+        std::vector<size_t> exact;
+        std::vector<size_t> prefix;
+        std::vector<std::pair<size_t, std::string>> wildcard;
+    };
+
+    size_t NodeFor(const char* name, size_t len);
+    const Node* Child(const Node& node, char c) const;
+
+    std::vector<Node> nodes_;
+    size_t num_rules_ = 0;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "perm_matcher.h"
+
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Rule {
+    std::string name;
+    bool prefix;
+    bool wildcard;
+};
+
+// The matching that devices.cpp used to do by walking the rule list.
+bool ListMatches(const char* path, const Rule& rule) {
+    if (rule.prefix) {
+        return strncmp(path, rule.name.c_str(), rule.name.size()) == 0;
+    } else if (rule.wildcard) {
+        return fnmatch(rule.name.c_str(), path, FNM_PATHNAME) == 0;
+    }
+    return strcmp(path, rule.name.c_str()) == 0;
+}
+
+ssize_t ListFindLast(const std::vector<Rule>& rules, const char* path) {
+    for (ssize_t i = rules.size() - 1; i >= 0; --i) {
+        if (ListMatches(path, rules[i])) return i;
+    }
+    return -1;
+}
+
+std::vector<size_t> ListFindAll(const std::vector<Rule>& rules, const char* path) {
+    std::vector<size_t> matches;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        if (ListMatches(path, rules[i])) matches.push_back(i);
+    }
+    return matches;
+}
+
+// Mirrors how ueventd.cpp classifies a rule name.
+Rule MakeRule(std::string name) {
+    Rule rule = { name, false, false };
+    size_t star = name.find('*');
+    if (star != std::string::npos && star == name.size() - 1) {
+        rule.prefix = true;
+        rule.name.erase(star);
+    } else if (star != std::string::npos) {
+        rule.wildcard = true;
+    }
+    return rule;
+}
+
+}  // namespace
+
+TEST(perm_matcher, empty) {
+    PermMatcher matcher;
+    EXPECT_EQ(-1, matcher.FindLast("/dev/null"));
+    EXPECT_TRUE(matcher.FindAll("/dev/null").empty());
+}
+
+TEST(perm_matcher, precedence) {
+    std::vector<Rule> rules = {
+        MakeRule("/dev/*"),
+        MakeRule("/dev/block/*"),
+        MakeRule("/dev/block/mmcblk0"),
+        MakeRule("/dev/block/mmcblk*p1"),
+        MakeRule("/dev/*"),
+        MakeRule("/dev/ttyS*"),
+        MakeRule("/dev/tty"),
+    };
+    PermMatcher matcher;
+    for (const Rule& rule : rules) {
+        matcher.Add(rule.name, rule.prefix, rule.wildcard);
+    }
+    EXPECT_EQ(7U, matcher.size());
+
+    EXPECT_EQ(4, matcher.FindLast("/dev/block/mmcblk0"));
+    EXPECT_EQ(5, matcher.FindLast("/dev/ttyS0"));
+    EXPECT_EQ(6, matcher.FindLast("/dev/tty"));
+    EXPECT_EQ(-1, matcher.FindLast("/sys/class"));
+    EXPECT_EQ(std::vector<size_t>({ 0, 1, 2, 4 }), matcher.FindAll("/dev/block/mmcblk0"));
+    EXPECT_EQ(std::vector<size_t>({ 0, 1, 3, 4 }), matcher.FindAll("/dev/block/mmcblk1p1"));
+}
+
+TEST(perm_matcher, matches_list_semantics) {
+    static const char* const kParts[] = {
+        "dev", "block", "platform", "msm_sdcc.1", "by-name", "mmcblk0", "mmcblk0p1",
+        "input", "event0", "event12", "snd", "pcmC0D0p", "ttyHS0", "ttyS1", "a", "",
+    };
+    static const char* const kGlobs[] = { "*", "?", "[0-9]", "event*", "mmcblk*p*" };
+    const size_t num_parts = sizeof(kParts) / sizeof(kParts[0]);
+    const size_t num_globs = sizeof(kGlobs) / sizeof(kGlobs[0]);
+
+    unsigned seed = 42;
+    auto random_path = [&](bool globs) {
+        std::string path = "/dev";
+        int depth = (globs ? 1 : 0) + rand_r(&seed) % 4;
+        for (int i = 0; i < depth; ++i) {
+            path += '/';
+            if (globs && rand_r(&seed) % 4 == 0) {
+                path += kGlobs[rand_r(&seed) % num_globs];
+            } else {
+                path += kParts[rand_r(&seed) % num_parts];
+            }
+        }
+        if (globs && rand_r(&seed) % 3 == 0) {
+            path += '*';
+        }
+        return path;
+    };
+
+    std::vector<Rule> rules;
+    PermMatcher matcher;
+    for (int i = 0; i < 400; ++i) {
+        rules.push_back(MakeRule(random_path(true)));
+        matcher.Add(rules.back().name, rules.back().prefix, rules.back().wildcard);
+    }
+
+    for (int i = 0; i < 5000; ++i) {
+        std::string path = random_path(false);
+        ASSERT_EQ(ListFindLast(rules, path.c_str()), matcher.FindLast(path.c_str())) << path;
+        ASSERT_EQ(ListFindAll(rules, path.c_str()), matcher.FindAll(path.c_str())) << path;
+    }
+}
@@ -17,15 +17,22 @@
 #include "service.h"
 
 #include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <selinux/selinux.h>
 
 #include <android-base/file.h>
+#include <android-base/macros.h>
 #include <android-base/stringprintf.h>
 #include <cutils/android_reboot.h>
 #include <cutils/sockets.h>
@@ -43,6 +50,62 @@ using android::base::WriteStringToFile;
 #define CRITICAL_CRASH_THRESHOLD    4       // if we crash >4 times ...
 #define CRITICAL_CRASH_WINDOW       (4*60)  // ... in 4 minutes, goto recovery
 
+// Stack for the spawn child. It only lives until execve().
+#define SPAWN_STACK_SIZE            (64 * 1024)
+
+// A failure in the spawn child, for init to log once the child has exec'd
+// or exited. |call| is a string literal and |arg| points into SpawnInfo.
+struct SpawnError {
+    const char* call;
+    const char* arg;
+    int error;
+};
+
+// Everything the spawn child needs, prepared by init beforehand. The child
+// shares init's memory until it execs, so it must not allocate or write to
+// any of it, nor call anything that is not async-signal-safe, such as the
+// logging functions: it only makes system calls on this data and reports
+// failures in |errors|.
+struct SpawnInfo {
+    const Service* service;
+    bool needs_console;
+    uid_t uid;
+    gid_t gid;
+    const std::vector<gid_t>* supp_gids;
+    IoSchedClass ioprio_class;
+    int ioprio_pri;
+    std::vector<const char*> writepid_files;
+    std::vector<char*> argv;
+    std::vector<char*> envp;
+    sigset_t sigmask;
+    SpawnError errors[4];
+    size_t num_errors;
+};
+
+// Records errno for the parent. When |errors| is full the last entry is
+// overwritten, so the failure that ends the child is never lost.
+static void spawn_error(SpawnInfo* info, const char* call, const char* arg) {
+    size_t i = std::min(info->num_errors, arraysize(info->errors) - 1);
+    info->errors[i] = { call, arg, errno };
+    if (info->num_errors < arraysize(info->errors)) {
+        info->num_errors++;
+    }
+}
+
+// Sets |key| to |value| in |env|, replacing any existing entry, the way
+// add_environment() does for init's own environment.
+static void set_spawn_environment(std::vector<std::string>* env, const std::string& key,
+                                  const std::string& value) {
+    std::string entry = key + "=" + value;
+    for (auto& e : *env) {
+        if (e.compare(0, key.size() + 1, key + "=") == 0) {
+            e = entry;
+            return;
+        }
+    }
+    env->push_back(entry);
+}
+
 SocketInfo::SocketInfo() : uid(0), gid(0), perm(0) {
 }
 
@@ -111,7 +174,7 @@ bool Service::Reap() {
         return true;
     }
 
-    pid_ = 0;
+    SetPid(0);
     flags_ &= (~SVC_RUNNING);
 
     // Oneshot processes go into the disabled state on exit,
@@ -144,6 +207,7 @@ bool Service::Reap() {
 
     flags_ &= (~SVC_RESTART);
     flags_ |= SVC_RESTARTING;
+    schedule_service_restart(name_, time_started_ + 5);
 
     // Execute all onrestart commands for this service.
     onrestart_.ExecuteAllCommands();
@@ -388,108 +452,89 @@ bool Service::Start() {
     }
 
     NOTICE("Starting service '%s'...\n", name_.c_str());
-
-    pid_t pid = fork();
-    if (pid == 0) {
-        umask(077);
-
-        for (const auto& ei : envvars_) {
-            add_environment(ei.name.c_str(), ei.value.c_str());
-        }
-
-        for (const auto& si : sockets_) {
-            int socket_type = ((si.type == "stream" ? SOCK_STREAM :
-                                (si.type == "dgram" ? SOCK_DGRAM :
-                                 SOCK_SEQPACKET)));
-            const char* socketcon =
-                !si.socketcon.empty() ? si.socketcon.c_str() : scon.c_str();
-
-            int s = create_socket(si.name.c_str(), socket_type, si.perm,
-                                  si.uid, si.gid, socketcon);
-            if (s >= 0) {
-                PublishSocket(si.name, s);
-            }
-        }
-
-        std::string pid_str = StringPrintf("%d", getpid());
-        for (const auto& file : writepid_files_) {
-            if (!WriteStringToFile(pid_str, file)) {
-                ERROR("couldn't write %s to %s: %s\n",
-                      pid_str.c_str(), file.c_str(), strerror(errno));
-            }
+    Timer t;
+
+    // Do all the work that allocates or touches init's state here, so the
+    // child only has to make system calls before it execs.
+    SpawnInfo info;
+    info.service = this;
+    info.needs_console = needs_console;
+    info.uid = uid_;
+    info.gid = gid_;
+    info.supp_gids = &supp_gids_;
+    info.ioprio_class = ioprio_class_;
+    info.ioprio_pri = ioprio_pri_;
+
+    std::vector<std::string> expanded_args(args_.size());
+    info.argv.push_back(const_cast<char*>(args_[0].c_str()));
+    for (std::size_t i = 1; i < args_.size(); ++i) {
+        if (!expand_props(args_[i], &expanded_args[i])) {
+            ERROR("%s: cannot expand '%s'\n", args_[0].c_str(), args_[i].c_str());
+            return false;
         }
+        info.argv.push_back(const_cast<char*>(expanded_args[i].c_str()));
+    }
+    info.argv.push_back(nullptr);
 
-        if (ioprio_class_ != IoSchedClass_NONE) {
-            if (android_set_ioprio(getpid(), ioprio_class_, ioprio_pri_)) {
-                ERROR("Failed to set pid %d ioprio = %d,%d: %s\n",
-                      getpid(), ioprio_class_, ioprio_pri_, strerror(errno));
-            }
-        }
+    std::vector<std::string> env;
+    for (const char* e : ENV) {
+        if (e) env.push_back(e);
+    }
+    for (const auto& ei : envvars_) {
+        set_spawn_environment(&env, ei.name, ei.value);
+    }
 
-        if (needs_console) {
-            setsid();
-            OpenConsole();
-        } else {
-            ZapStdio();
+    std::vector<int> socket_fds;
+    for (const auto& si : sockets_) {
+        int socket_type = ((si.type == "stream" ? SOCK_STREAM :
+                            (si.type == "dgram" ? SOCK_DGRAM :
+                             SOCK_SEQPACKET)));
+        const char* socketcon =
+            !si.socketcon.empty() ? si.socketcon.c_str() : scon.c_str();
+
+        int s = create_socket(si.name.c_str(), socket_type, si.perm,
+                              si.uid, si.gid, socketcon);
+        if (s >= 0) {
+            PublishSocket(si.name, s, &env);
+            socket_fds.push_back(s);
         }
+    }
+    for (const auto& e : env) {
+        info.envp.push_back(const_cast<char*>(e.c_str()));
+    }
+    info.envp.push_back(nullptr);
 
-        setpgid(0, getpid());
-
-        // As requested, set our gid, supplemental gids, and uid.
-        if (gid_) {
-            if (setgid(gid_) != 0) {
-                ERROR("setgid failed: %s\n", strerror(errno));
-                _exit(127);
-            }
-        }
-        if (!supp_gids_.empty()) {
-            if (setgroups(supp_gids_.size(), &supp_gids_[0]) != 0) {
-                ERROR("setgroups failed: %s\n", strerror(errno));
-                _exit(127);
-            }
-        }
-        if (uid_) {
-            if (setuid(uid_) != 0) {
-                ERROR("setuid failed: %s\n", strerror(errno));
-                _exit(127);
-            }
-        }
-        if (!seclabel_.empty()) {
-            if (setexeccon(seclabel_.c_str()) < 0) {
-                ERROR("cannot setexeccon('%s'): %s\n",
-                      seclabel_.c_str(), strerror(errno));
-                _exit(127);
-            }
-        }
+    for (const auto& file : writepid_files_) {
+        info.writepid_files.push_back(file.c_str());
+    }
 
-        std::vector<std::string> expanded_args;
-        std::vector<char*> strs;
-        expanded_args.resize(args_.size());
-        strs.push_back(const_cast<char*>(args_[0].c_str()));
-        for (std::size_t i = 1; i < args_.size(); ++i) {
-            if (!expand_props(args_[i], &expanded_args[i])) {
-                ERROR("%s: cannot expand '%s'\n", args_[0].c_str(), args_[i].c_str());
-                _exit(127);
-            }
-            strs.push_back(const_cast<char*>(expanded_args[i].c_str()));
-        }
-        strs.push_back(nullptr);
+    // The exec context is carried in the credentials the child inherits,
+    // so set it here and put ours back once the child has exec'd.
+    if (!seclabel_.empty() && setexeccon(seclabel_.c_str()) < 0) {
+        ERROR("cannot setexeccon('%s'): %s\n", seclabel_.c_str(), strerror(errno));
+        for (int fd : socket_fds) close(fd);
+        return false;
+    }
 
-        if (execve(strs[0], (char**) &strs[0], (char**) ENV) < 0) {
-            ERROR("cannot execve('%s'): %s\n", strs[0], strerror(errno));
-        }
+    pid_t pid = Spawn(&info);
 
-        _exit(127);
+    if (!seclabel_.empty()) {
+        setexeccon(nullptr);
+    }
+    for (int fd : socket_fds) {
+        close(fd);
     }
 
     if (pid < 0) {
         ERROR("failed to start '%s'\n", name_.c_str());
-        pid_ = 0;
+        SetPid(0);
         return false;
     }
 
+    INFO("service '%s' (pid %d) spawned in %.2fms\n", name_.c_str(), pid, t.duration() * 1000);
+
     time_started_ = gettime();
-    pid_ = pid;
+    SetPid(pid);
     flags_ |= SVC_RUNNING;
 
     if ((flags_ & SVC_EXEC) != 0) {
@@ -502,6 +547,133 @@ bool Service::Start() {
     return true;
 }
 
+// Runs in the child, on its own stack but in init's address space, until
+// execve() replaces it.
+int Service::SpawnChild(void* arg) {
+    SpawnInfo* info = reinterpret_cast<SpawnInfo*>(arg);
+
+    // Signal handlers are init's; drop them before letting signals in.
+    for (int sig = 1; sig < _NSIG; ++sig) {
+        struct sigaction sa;
+        if (sigaction(sig, nullptr, &sa) == 0 && sa.sa_handler != SIG_DFL &&
+            sa.sa_handler != SIG_IGN) {
+            sa.sa_handler = SIG_DFL;
+            sigaction(sig, &sa, nullptr);
+        }
+    }
+    sigprocmask(SIG_SETMASK, &info->sigmask, nullptr);
+
+    umask(077);
+
+    // getpid() may answer from a cache shared with init; ask the kernel.
+    pid_t pid = syscall(__NR_getpid);
+    char pid_str[16];
+    char* p = pid_str + sizeof(pid_str);
+    do {
+        *--p = '0' + pid % 10;
+        pid /= 10;
+    } while (pid);
+    size_t pid_len = pid_str + sizeof(pid_str) - p;
+    for (const char* file : info->writepid_files) {
+        int fd = TEMP_FAILURE_RETRY(open(file, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666));
+        if (fd < 0 || TEMP_FAILURE_RETRY(write(fd, p, pid_len)) != (ssize_t) pid_len) {
+            spawn_error(info, "write pid to", file);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    if (info->ioprio_class != IoSchedClass_NONE) {
+        if (android_set_ioprio(0, info->ioprio_class, info->ioprio_pri)) {
+            spawn_error(info, "set ioprio", nullptr);
+        }
+    }
+
+    if (info->needs_console) {
+        setsid();
+        info->service->OpenConsole();
+    } else {
+        info->service->ZapStdio();
+    }
+
+    setpgid(0, 0);
+
+    // As requested, set our gid, supplemental gids, and uid.
+    if (info->gid) {
+        if (setgid(info->gid) != 0) {
+            spawn_error(info, "setgid", nullptr);
+            _exit(127);
+        }
+    }
+    if (!info->supp_gids->empty()) {
+        if (setgroups(info->supp_gids->size(), info->supp_gids->data()) != 0) {
+            spawn_error(info, "setgroups", nullptr);
+            _exit(127);
+        }
+    }
+    if (info->uid) {
+        if (setuid(info->uid) != 0) {
+            spawn_error(info, "setuid", nullptr);
+            _exit(127);
+        }
+    }
+
+    execve(info->argv[0], info->argv.data(), info->envp.data());
+    spawn_error(info, "execve", info->argv[0]);
+    _exit(127);
+}
+
+// Starts the child with clone(CLONE_VM|CLONE_VFORK) rather than fork(), so
+// none of init's page tables have to be copied for a process that is about
+// to exec anyway. Init is suspended until the child execs or exits.
+pid_t Service::Spawn(SpawnInfo* info) const {
+    static void* stack = nullptr;
+    if (!stack) {
+        stack = mmap(nullptr, SPAWN_STACK_SIZE, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED) {
+            stack = nullptr;
+            ERROR("cannot allocate spawn stack: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    // Keep init's signal handlers from running on the child's stack before
+    // it has had a chance to reset them.
+    sigset_t all;
+    sigfillset(&all);
+    sigprocmask(SIG_SETMASK, &all, &info->sigmask);
+
+    info->num_errors = 0;
+    pid_t pid = clone(SpawnChild, static_cast<char*>(stack) + SPAWN_STACK_SIZE,
+                      CLONE_VM | CLONE_VFORK | SIGCHLD, info);
+    int saved_errno = errno;
+
+    sigprocmask(SIG_SETMASK, &info->sigmask, nullptr);
+
+    if (pid < 0) {
+        ERROR("clone failed for '%s': %s\n", name_.c_str(), strerror(saved_errno));
+        return pid;
+    }
+
+    // The child has exec'd or exited by now, and left us its failures.
+    for (size_t i = 0; i < info->num_errors; ++i) {
+        const SpawnError& e = info->errors[i];
+        if (e.arg) {
+            ERROR("cannot %s '%s' for '%s' (pid %d): %s\n",
+                  e.call, e.arg, name_.c_str(), pid, strerror(e.error));
+        } else {
+            ERROR("cannot %s for '%s' (pid %d): %s\n",
+                  e.call, name_.c_str(), pid, strerror(e.error));
+        }
+    }
+    return pid;
+}
+
+void Service::SetPid(pid_t pid) {
+    ServiceManager::GetInstance().UpdatePid(this, pid_, pid);
+    pid_ = pid;
+}
+
 bool Service::StartIfNotDisabled() {
     if (!(flags_ & SVC_DISABLED)) {
         return Start();
@@ -612,10 +784,11 @@ void Service::OpenConsole() const {
     close(fd);
 }
 
-void Service::PublishSocket(const std::string& name, int fd) const {
+void Service::PublishSocket(const std::string& name, int fd,
+                            std::vector<std::string>* env) const {
     std::string key = StringPrintf(ANDROID_SOCKET_ENV_PREFIX "%s", name.c_str());
     std::string val = StringPrintf("%d", fd);
-    add_environment(key.c_str(), val.c_str());
+    set_spawn_environment(env, key, val);
 
     /* make sure we don't close-on-exec */
     fcntl(fd, F_SETFD, 0);
@@ -638,9 +811,30 @@ void ServiceManager::AddService(std::unique_ptr<Service> service) {
               service->name().c_str());
         return;
     }
+    IndexService(service.get());
     services_.emplace_back(std::move(service));
 }
 
+void ServiceManager::IndexService(Service* svc) {
+    services_by_name_[svc->name()] = svc;
+    services_by_class_[svc->classname()].push_back(svc);
+    if (svc->pid()) {
+        services_by_pid_[svc->pid()] = svc;
+    }
+}
+
+void ServiceManager::UpdatePid(Service* svc, pid_t old_pid, pid_t new_pid) {
+    if (old_pid) {
+        auto it = services_by_pid_.find(old_pid);
+        if (it != services_by_pid_.end() && it->second == svc) {
+            services_by_pid_.erase(it);
+        }
+    }
+    if (new_pid) {
+        services_by_pid_[new_pid] = svc;
+    }
+}
+
 Service* ServiceManager::MakeExecOneshotService(const std::vector<std::string>& args) {
     // Parse the arguments: exec [SECLABEL [UID [GID]*] --] COMMAND ARGS...
     // SECLABEL can be a - to denote default
@@ -692,29 +886,24 @@ Service* ServiceManager::MakeExecOneshotService(const std::vector<std::string>&
         return nullptr;
     }
     Service* svc = svc_p.get();
+    IndexService(svc);
     services_.push_back(std::move(svc_p));
 
     return svc;
 }
 
 Service* ServiceManager::FindServiceByName(const std::string& name) const {
-    auto svc = std::find_if(services_.begin(), services_.end(),
-                            [&name] (const std::unique_ptr<Service>& s) {
-                                return name == s->name();
-                            });
-    if (svc != services_.end()) {
-        return svc->get();
+    auto svc = services_by_name_.find(name);
+    if (svc != services_by_name_.end()) {
+        return svc->second;
     }
     return nullptr;
 }
 
 Service* ServiceManager::FindServiceByPid(pid_t pid) const {
-    auto svc = std::find_if(services_.begin(), services_.end(),
-                            [&pid] (const std::unique_ptr<Service>& s) {
-                                return s->pid() == pid;
-                            });
-    if (svc != services_.end()) {
-        return svc->get();
+    auto svc = services_by_pid_.find(pid);
+    if (svc != services_by_pid_.end()) {
+        return svc->second;
     }
     return nullptr;
 }
@@ -739,10 +928,14 @@ void ServiceManager::ForEachService(std::function<void(Service*)> callback) cons
 
 void ServiceManager::ForEachServiceInClass(const std::string& classname,
                                            void (*func)(Service* svc)) const {
-    for (const auto& s : services_) {
-        if (classname == s->classname()) {
-            func(s.get());
-        }
+    auto it = services_by_class_.find(classname);
+    if (it == services_by_class_.end()) {
+        return;
+    }
+    // Copy, in case |func| ends up adding or removing services.
+    std::vector<Service*> services(it->second);
+    for (Service* s : services) {
+        func(s);
     }
 }
 
@@ -756,14 +949,25 @@ void ServiceManager::ForEachServiceWithFlags(unsigned matchflags,
 }
 
 void ServiceManager::RemoveService(const Service& svc) {
-    auto svc_it = std::find_if(services_.begin(), services_.end(),
-                               [&svc] (const std::unique_ptr<Service>& s) {
-                                   return svc.name() == s->name();
-                               });
-    if (svc_it == services_.end()) {
+    auto name_it = services_by_name_.find(svc.name());
+    if (name_it == services_by_name_.end()) {
         return;
     }
+    Service* s = name_it->second;
+    services_by_name_.erase(name_it);
 
+    UpdatePid(s, s->pid(), 0);
+
+    auto& in_class = services_by_class_[s->classname()];
+    in_class.erase(std::find(in_class.begin(), in_class.end(), s));
+    if (in_class.empty()) {
+        services_by_class_.erase(s->classname());
+    }
+
+    auto svc_it = std::find_if(services_.begin(), services_.end(),
+                               [s] (const std::unique_ptr<Service>& p) {
+                                   return p.get() == s;
+                               });
     services_.erase(svc_it);
 }
 
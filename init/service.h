@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "action.h"
@@ -46,6 +47,7 @@
 
 class Action;
 class ServiceManager;
+struct SpawnInfo;
 
 struct SocketInfo {
     SocketInfo();
@@ -106,10 +108,14 @@ private:
     class OptionHandlerMap;
 
     void NotifyStateChange(const std::string& new_state) const;
+    void SetPid(pid_t pid);
     void StopOrReset(int how);
     void ZapStdio() const;
     void OpenConsole() const;
-    void PublishSocket(const std::string& name, int fd) const;
+    void PublishSocket(const std::string& name, int fd,
+                       std::vector<std::string>* env) const;
+    pid_t Spawn(SpawnInfo* info) const;
+    static int SpawnChild(void* arg);
 
     bool HandleClass(const std::vector<std::string>& args, std::string* err);
     bool HandleConsole(const std::vector<std::string>& args, std::string* err);
@@ -176,15 +182,25 @@ public:
     void RemoveService(const Service& svc);
     void DumpState() const;
 
+    // Keeps the pid index in step when |svc| is started or reaped.
+    void UpdatePid(Service* svc, pid_t old_pid, pid_t new_pid);
+
 private:
     ServiceManager();
 
+    void IndexService(Service* svc);
+
     // Cleans up a child process that exited.
     // Returns true iff a children was cleaned up.
     bool ReapOneProcess();
 
     static int exec_count_; // Every service needs a unique name.
     std::vector<std::unique_ptr<Service>> services_;
+
+    // Lookup indices over |services_|; class lists keep definition order.
+    std::unordered_map<std::string, Service*> services_by_name_;
+    std::unordered_map<pid_t, Service*> services_by_pid_;
+    std::unordered_map<std::string, std::vector<Service*>> services_by_class_;
 };
 
 class ServiceParser : public SectionParser {
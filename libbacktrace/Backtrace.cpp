@@ -53,7 +53,14 @@ Backtrace::~Backtrace() {
 }
 
 std::string Backtrace::GetFunctionName(uintptr_t pc, uintptr_t* offset) {
-  std::string func_name = GetFunctionNameRaw(pc, offset);
+  std::string func_name;
+  if (map_ != nullptr && map_->GetCachedFunctionName(pc, &func_name, offset)) {
+    return func_name;
+  }
+  func_name = GetFunctionNameRaw(pc, offset);
+  if (map_ != nullptr) {
+    map_->CacheFunctionName(pc, func_name, *offset);
+  }
   return func_name;
 }
 
@@ -45,6 +45,28 @@ void BacktraceMap::FillIn(uintptr_t addr, backtrace_map_t* map) {
   *map = {};
 }
 
+bool BacktraceMap::GetCachedFunctionName(uintptr_t pc, std::string* name, uintptr_t* offset) {
+  if (!cache_function_names_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(function_names_lock_);
+  auto entry = function_names_.find(pc);
+  if (entry == function_names_.end()) {
+    return false;
+  }
+  *name = entry->second.first;
+  *offset = entry->second.second;
+  return true;
+}
+
+void BacktraceMap::CacheFunctionName(uintptr_t pc, const std::string& name, uintptr_t offset) {
+  if (!cache_function_names_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(function_names_lock_);
+  function_names_.emplace(pc, std::make_pair(name, offset));
+}
+
 bool BacktraceMap::ParseLine(const char* line, backtrace_map_t* map) {
   unsigned long int start;
   unsigned long int end;
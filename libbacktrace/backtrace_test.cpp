@@ -774,6 +774,50 @@ TEST(libbacktrace, fillin_erases) {
   ASSERT_EQ("", map.name);
 }
 
+TEST(libbacktrace, function_name_cache) {
+  std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(getpid()));
+  ASSERT_TRUE(map.get() != nullptr);
+
+  std::string name;
+  uintptr_t offset;
+  // Nothing is cached until the cache is enabled.
+  map->CacheFunctionName(0x1000, "not_cached", 0x10);
+  ASSERT_FALSE(map->GetCachedFunctionName(0x1000, &name, &offset));
+
+  map->EnableFunctionNameCache();
+  ASSERT_FALSE(map->GetCachedFunctionName(0x1000, &name, &offset));
+  map->CacheFunctionName(0x1000, "cached", 0x10);
+  ASSERT_TRUE(map->GetCachedFunctionName(0x1000, &name, &offset));
+  ASSERT_EQ("cached", name);
+  ASSERT_EQ(static_cast<uintptr_t>(0x10), offset);
+}
+
+TEST(libbacktrace, function_name_cache_unwind) {
+  std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(getpid()));
+  ASSERT_TRUE(map.get() != nullptr);
+  map->EnableFunctionNameCache();
+
+  // Unwinding twice through a caching map, the second time from the
+  // cache, must give the same frames as an unwind with its own map.
+  std::unique_ptr<Backtrace> expected(Backtrace::Create(getpid(), BACKTRACE_CURRENT_THREAD));
+  ASSERT_TRUE(expected.get() != nullptr);
+  ASSERT_TRUE(expected->Unwind(0));
+  for (size_t i = 0; i < 2; i++) {
+    std::unique_ptr<Backtrace> backtrace(
+        Backtrace::Create(getpid(), BACKTRACE_CURRENT_THREAD, map.get()));
+    ASSERT_TRUE(backtrace.get() != nullptr);
+    ASSERT_TRUE(backtrace->Unwind(0));
+    ASSERT_EQ(BACKTRACE_UNWIND_NO_ERROR, backtrace->GetError());
+    ASSERT_EQ(expected->NumFrames(), backtrace->NumFrames());
+    // The innermost frame is this test, which called Unwind from
+    // different places, so only compare the callers.
+    for (size_t j = 1; j < backtrace->NumFrames(); j++) {
+      EXPECT_EQ(expected->GetFrame(j)->func_name, backtrace->GetFrame(j)->func_name);
+      EXPECT_EQ(expected->GetFrame(j)->func_offset, backtrace->GetFrame(j)->func_offset);
+    }
+  }
+}
+
 TEST(libbacktrace, format_test) {
   std::unique_ptr<Backtrace> backtrace(Backtrace::Create(getpid(), BACKTRACE_CURRENT_THREAD));
   ASSERT_TRUE(backtrace.get() != nullptr);
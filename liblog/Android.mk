@@ -79,7 +79,33 @@ LOCAL_LDFLAGS_arm := -Wl,--hash-style=both
 
 LOCAL_SANITIZE := never
 LOCAL_CXX_STL := none
+LOCAL_REQUIRED_MODULES := event-log-tags.idx
 
 include $(BUILD_SHARED_LIBRARY)
 
+# Binary index of /system/etc/event-log-tags, see EVENT_TAG_MAP_INDEX_SUFFIX
+# ========================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := event-log-tags-index
+LOCAL_SRC_FILES := event_log_tags_index.c
+LOCAL_STATIC_LIBRARIES := liblog
+LOCAL_CFLAGS := -Werror
+LOCAL_MODULE_HOST_OS := darwin linux
+include $(BUILD_HOST_EXECUTABLE)
+
+event_log_tags_index_tool := $(LOCAL_INSTALLED_MODULE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := event-log-tags.idx
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $(TARGET_OUT_ETC)
+include $(BUILD_SYSTEM)/base_rules.mk
+
+$(LOCAL_BUILT_MODULE): $(TARGET_OUT_ETC)/event-log-tags $(event_log_tags_index_tool)
+	@echo "Generate: $< -> $@"
+	@mkdir -p $(dir $@)
+	$(hide) $(event_log_tags_index_tool) $< $@
+
+event_log_tags_index_tool :=
+
 include $(call first-makefiles-under,$(LOCAL_PATH))
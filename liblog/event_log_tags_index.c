@@ -0,0 +1,40 @@
+/*
+** Copyright 2016, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Host tool that writes the binary index of an event log tags file, so the
+ * image ships one and nothing has to parse or write it on the device.
+ */
+
+#include <stdio.h>
+
+#include <log/event_tag_map.h>
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <event-log-tags> <index>\n", argv[0]);
+        return 1;
+    }
+
+    if (android_writeEventTagMapIndex(argv[1], argv[2]) != 0) {
+        fprintf(stderr, "%s: cannot index %s into %s\n",
+                argv[0], argv[1], argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -17,9 +17,13 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <log/event_tag_map.h>
 #include <log/log.h>
@@ -36,6 +40,33 @@ typedef struct EventTag {
     const char*     tagStr;
 } EventTag;
 
+/*
+ * Binary index of a map file, written by android_writeEventTagMapIndex.
+ *
+ * The header is followed by an open addressing hash table of numSlots
+ * (a power of two) slots, probed linearly, and by the nul terminated tag
+ * strings. Offset 0 of the strings is always '\0' and marks an empty slot,
+ * and there is always at least one. The index is only used while the size
+ * and FNV-1a hash of the text file match those recorded in the header; the
+ * hash is only taken once an index of the right size has been found.
+ */
+#define EVENT_TAG_INDEX_MAGIC "EVTAGIX2"
+
+typedef struct EventTagIndexHeader {
+    char            magic[8];
+    uint64_t        sourceSize;
+    uint64_t        sourceHash;
+    uint32_t        numSlots;
+    uint32_t        numTags;
+    uint32_t        stringsLen;
+    uint32_t        reserved;
+} EventTagIndexHeader;
+
+typedef struct EventTagIndexSlot {
+    uint32_t        tagIndex;
+    uint32_t        strOffset;
+} EventTagIndexSlot;
+
 /*
  * Map.
  */
@@ -47,9 +78,20 @@ struct EventTagMap {
     /* array of event tags, sorted numerically by tag index */
     EventTag*       tagArray;
     int             numTags;
+
+    /* set instead of tagArray when loaded from a binary index */
+    const EventTagIndexSlot* slots;
+    uint32_t        slotMask;
+    const char*     strings;
+    uint32_t        stringsLen;
 };
 
 /* fwd */
+static EventTagMap* openMap(const char* fileName, int useIndex,
+                            uint64_t* sourceHash);
+static uint64_t hashMapFile(const EventTagMap* map);
+static char* indexFileName(const char* fileName);
+static int openIndex(EventTagMap* map, const char* fileName);
 static int processFile(EventTagMap* map);
 static int countMapLines(const EventTagMap* map);
 static int parseMapLines(EventTagMap* map);
@@ -60,10 +102,21 @@ static int sortTags(EventTagMap* map);
 /*
  * Open the map file and allocate a structure to manage it.
  *
- * We create a private mapping because we want to terminate the log tag
- * strings with '\0'.
+ * If a binary index of the current contents of the file is next to it, the
+ * index is used instead of parsing the file.
  */
 LIBLOG_ABI_PUBLIC EventTagMap* android_openEventTagMap(const char* fileName)
+{
+    return openMap(fileName, 1, NULL);
+}
+
+/*
+ * We create a private mapping because we want to terminate the log tag
+ * strings with '\0'.  If sourceHash is set, it receives the hash of the
+ * file, taken before parsing modifies the mapping.
+ */
+static EventTagMap* openMap(const char* fileName, int useIndex,
+                            uint64_t* sourceHash)
 {
     EventTagMap* newTagMap;
     off_t end;
@@ -96,6 +149,15 @@ LIBLOG_ABI_PUBLIC EventTagMap* android_openEventTagMap(const char* fileName)
     }
     newTagMap->mapLen = end;
 
+    if (sourceHash)
+        *sourceHash = hashMapFile(newTagMap);
+
+    /* a current binary index saves parsing the text */
+    if (useIndex && (openIndex(newTagMap, fileName) == 0)) {
+        close(fd);
+        return newTagMap;
+    }
+
     if (processFile(newTagMap) != 0)
         goto fail;
 
@@ -119,10 +181,46 @@ LIBLOG_ABI_PUBLIC void android_closeEventTagMap(EventTagMap* map)
     if (map == NULL)
         return;
 
-    munmap(map->mapAddr, map->mapLen);
+    if (map->mapAddr && (map->mapAddr != MAP_FAILED))
+        munmap(map->mapAddr, map->mapLen);
+    free(map->tagArray);
     free(map);
 }
 
+static inline uint32_t hashTagIndex(unsigned int tag)
+{
+    return tag * 2654435761U;
+}
+
+/*
+ * FNV-1a hash of the map file, taken before parsing modifies the mapping.
+ */
+static uint64_t hashMapFile(const EventTagMap* map)
+{
+    const unsigned char* cp = (const unsigned char*) map->mapAddr;
+    const unsigned char* endp = cp + map->mapLen;
+    uint64_t hash = 14695981039346656037ULL;
+
+    while (cp < endp) {
+        hash ^= *cp++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * Returns the name of the index of fileName, which the caller frees.
+ */
+static char* indexFileName(const char* fileName)
+{
+    size_t len = strlen(fileName) + sizeof(EVENT_TAG_MAP_INDEX_SUFFIX);
+    char* indexName = malloc(len);
+
+    if (indexName)
+        snprintf(indexName, len, "%s%s", fileName, EVENT_TAG_MAP_INDEX_SUFFIX);
+    return indexName;
+}
+
 /*
  * Look up an entry in the map.
  *
@@ -133,6 +231,23 @@ LIBLOG_ABI_PUBLIC const char* android_lookupEventTag(const EventTagMap* map,
 {
     int hi, lo, mid;
 
+    if (map->slots) {
+        uint32_t i = hashTagIndex(tag) & map->slotMask;
+        uint32_t n;
+
+        /* openIndex checked for an empty slot, but never probe past them all */
+        for (n = 0; n <= map->slotMask; n++) {
+            const EventTagIndexSlot* slot = &map->slots[i];
+
+            if (slot->strOffset == 0)
+                return NULL;
+            if (slot->tagIndex == (unsigned int)tag)
+                return map->strings + slot->strOffset;
+            i = (i + 1) & map->slotMask;
+        }
+        return NULL;
+    }
+
     lo = 0;
     hi = map->numTags-1;
 
@@ -158,6 +273,204 @@ LIBLOG_ABI_PUBLIC const char* android_lookupEventTag(const EventTagMap* map,
 
 
 
+/*
+ * Write a binary index of mapFileName to indexName, through a temporary
+ * file of its own so that readers, and other writers, never see a partial
+ * index.
+ */
+LIBLOG_ABI_PUBLIC int android_writeEventTagMapIndex(const char* mapFileName,
+                                                    const char* indexName)
+{
+    EventTagIndexHeader header;
+    EventTagIndexSlot* slots = NULL;
+    char* strings = NULL;
+    char* tmpName = NULL;
+    EventTagMap* map;
+    uint64_t sourceHash;
+    uint32_t numSlots, numTags, stringsLen, i;
+    size_t len;
+    FILE* fp = NULL;
+    int fd, ret = -1;
+
+    map = openMap(mapFileName, 0, &sourceHash);
+    if (!map) {
+        return -1;
+    }
+
+    numTags = map->numTags;
+    stringsLen = 1;
+    for (i = 0; i < numTags; i++) {
+        stringsLen += strlen(map->tagArray[i].tagStr) + 1;
+    }
+
+    /* keep the load factor at or below 1/2, and at least one slot empty */
+    numSlots = 1;
+    while (numSlots <= (numTags * 2)) {
+        numSlots <<= 1;
+    }
+
+    slots = calloc(numSlots, sizeof(EventTagIndexSlot));
+    strings = malloc(stringsLen);
+    if (!slots || !strings) {
+        goto done;
+    }
+
+    strings[0] = '\0';
+    stringsLen = 1;
+    for (i = 0; i < numTags; i++) {
+        const EventTag* tag = &map->tagArray[i];
+        uint32_t slot = hashTagIndex(tag->tagIndex) & (numSlots - 1);
+
+        while (slots[slot].strOffset) {
+            slot = (slot + 1) & (numSlots - 1);
+        }
+        slots[slot].tagIndex = tag->tagIndex;
+        slots[slot].strOffset = stringsLen;
+        len = strlen(tag->tagStr) + 1;
+        memcpy(strings + stringsLen, tag->tagStr, len);
+        stringsLen += len;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVENT_TAG_INDEX_MAGIC, sizeof(header.magic));
+    header.sourceSize = map->mapLen;
+    header.sourceHash = sourceHash;
+    header.numSlots = numSlots;
+    header.numTags = numTags;
+    header.stringsLen = stringsLen;
+
+    len = strlen(indexName) + sizeof(".XXXXXX");
+    tmpName = malloc(len);
+    if (!tmpName) {
+        goto done;
+    }
+    snprintf(tmpName, len, "%s.XXXXXX", indexName);
+    fd = mkstemp(tmpName);
+    if (fd < 0) {
+        goto done;
+    }
+    /* mkstemp creates it 0600, the index is for every reader */
+    fp = (fchmod(fd, 0644) == 0) ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        close(fd);
+        unlink(tmpName);
+        goto done;
+    }
+    if ((fwrite(&header, sizeof(header), 1, fp) != 1)
+            || (fwrite(slots, sizeof(EventTagIndexSlot), numSlots, fp) != numSlots)
+            || (fwrite(strings, 1, stringsLen, fp) != stringsLen)) {
+        fclose(fp);
+        unlink(tmpName);
+        goto done;
+    }
+    if (fclose(fp) != 0) {
+        unlink(tmpName);
+        goto done;
+    }
+    if (rename(tmpName, indexName) != 0) {
+        unlink(tmpName);
+        goto done;
+    }
+    ret = 0;
+
+done:
+    free(tmpName);
+    free(strings);
+    free(slots);
+    android_closeEventTagMap(map);
+    return ret;
+}
+
+/*
+ * Map the binary index next to the map file, if there is one and it was
+ * built from the current contents of the map file.
+ *
+ * Returns 0 on success, nonzero if the text file has to be parsed.
+ */
+static int openIndex(EventTagMap* map, const char* fileName)
+{
+    const EventTagIndexHeader* header;
+    const EventTagIndexSlot* slots;
+    const char* strings;
+    char* indexName;
+    struct stat st;
+    void* addr;
+    size_t expected;
+    uint32_t i;
+    int empty;
+    int fd;
+
+    indexName = indexFileName(fileName);
+    if (!indexName)
+        return -1;
+    fd = open(indexName, O_RDONLY | O_CLOEXEC);
+    free(indexName);
+    if (fd < 0)
+        return -1;
+
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(*header))) {
+        close(fd);
+        return -1;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return -1;
+
+    header = (const EventTagIndexHeader*) addr;
+    expected = sizeof(*header)
+             + (size_t)header->numSlots * sizeof(EventTagIndexSlot)
+             + header->stringsLen;
+    if (memcmp(header->magic, EVENT_TAG_INDEX_MAGIC, sizeof(header->magic))
+            || (header->sourceSize != map->mapLen)
+            || !header->numSlots
+            || (header->numSlots & (header->numSlots - 1))
+            || (header->numTags >= header->numSlots)
+            || !header->stringsLen
+            || (expected != (size_t)st.st_size)) {
+        munmap(addr, st.st_size);
+        return -1;
+    }
+
+    /*
+     * Do not trust the header: every offset must be inside the strings, and
+     * there must be an empty slot for lookups of unknown tags to stop at.
+     */
+    slots = (const EventTagIndexSlot*) (header + 1);
+    strings = (const char*) (slots + header->numSlots);
+    empty = 0;
+    for (i = 0; i < header->numSlots; i++) {
+        if (slots[i].strOffset == 0)
+            empty = 1;
+        else if (slots[i].strOffset >= header->stringsLen)
+            break;
+    }
+    if ((i < header->numSlots) || !empty
+            || (strings[header->stringsLen - 1] != '\0')) {
+        munmap(addr, st.st_size);
+        return -1;
+    }
+
+    /* only now is it worth reading all of the text file */
+    if (header->sourceHash != hashMapFile(map)) {
+        munmap(addr, st.st_size);
+        return -1;
+    }
+
+    /* the index replaces the text file */
+    munmap(map->mapAddr, map->mapLen);
+    map->mapAddr = addr;
+    map->mapLen = st.st_size;
+    map->numTags = header->numTags;
+    map->slots = slots;
+    map->slotMask = header->numSlots - 1;
+    map->strings = strings;
+    map->stringsLen = header->stringsLen;
+
+    return 0;
+}
+
 /*
  * Determine whether "c" is a whitespace char.
  */
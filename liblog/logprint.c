@@ -41,13 +41,26 @@
 
 typedef struct FilterInfo_t {
     char *mTag;
+    uint32_t mHash;
     android_LogPriority mPri;
     struct FilterInfo_t *p_next;
+    struct FilterInfo_t *p_hash_next;
 } FilterInfo;
 
+/* Initial number of buckets in the filter hash table, must be a power of 2 */
+#define FILTER_HASH_INITIAL_SIZE 16
+
 struct AndroidLogFormat_t {
     android_LogPriority global_pri;
+    /*
+     * Every tag has exactly one FilterInfo, a later rule for the same tag
+     * overrides the priority in place. The filters are chained in a list
+     * that owns them and indexed by a hash table on the tag.
+     */
     FilterInfo *filters;
+    FilterInfo **filter_table;
+    size_t filter_table_size;
+    size_t filter_count;
     AndroidLogPrintFormat format;
     bool colored_output;
     bool usec_time_output;
@@ -57,6 +70,15 @@ struct AndroidLogFormat_t {
     bool epoch_output;
     bool monotonic_output;
     bool uid_output;
+    /*
+     * Seconds part of the last formatted time stamp. Consecutive log lines
+     * mostly share the same second, so localtime_r and strftime only need
+     * to run when it changes. A zero length marks the cache as invalid.
+     */
+    time_t cached_sec;
+    size_t cached_time_len;
+    char cached_time[32];
+    char cached_zone[16];
 };
 
 /*
@@ -73,18 +95,98 @@ struct AndroidLogFormat_t {
 #define ANDROID_COLOR_RED     196
 #define ANDROID_COLOR_YELLOW  226
 
+/* FNV-1a over the nul terminated tag */
+static uint32_t filterHash(const char *tag)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*tag) {
+        hash ^= (uint8_t)*tag++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
 static FilterInfo * filterinfo_new(const char * tag, android_LogPriority pri)
 {
     FilterInfo *p_ret;
 
     p_ret = (FilterInfo *)calloc(1, sizeof(FilterInfo));
+    if (!p_ret) {
+        return NULL;
+    }
     p_ret->mTag = strdup(tag);
+    if (!p_ret->mTag) {
+        free(p_ret);
+        return NULL;
+    }
+    p_ret->mHash = filterHash(tag);
     p_ret->mPri = pri;
 
     return p_ret;
 }
 
-/* balance to above, filterinfo_free left unimplemented */
+static void filterinfo_free(FilterInfo *p_info)
+{
+    free(p_info->mTag);
+    free(p_info);
+}
+
+static FilterInfo *filterFind(AndroidLogFormat *p_format,
+                              const char *tag, uint32_t hash)
+{
+    FilterInfo *p_curFilter;
+
+    if (!p_format->filter_table) {
+        return NULL;
+    }
+
+    for (p_curFilter = p_format->filter_table[
+                hash & (p_format->filter_table_size - 1)]
+            ; p_curFilter != NULL
+            ; p_curFilter = p_curFilter->p_hash_next
+    ) {
+        if ((p_curFilter->mHash == hash) && !strcmp(tag, p_curFilter->mTag)) {
+            return p_curFilter;
+        }
+    }
+    return NULL;
+}
+
+/* Keeps the load factor of the filter hash table at or below 3/4 */
+static int filterTableReserve(AndroidLogFormat *p_format, size_t count)
+{
+    size_t size = p_format->filter_table_size;
+    FilterInfo **table;
+    FilterInfo *p_curFilter;
+
+    if (!size) {
+        size = FILTER_HASH_INITIAL_SIZE;
+    }
+    while ((count * 4) > (size * 3)) {
+        size *= 2;
+    }
+    if (size == p_format->filter_table_size) {
+        return 0;
+    }
+
+    table = (FilterInfo **)calloc(size, sizeof(FilterInfo *));
+    if (!table) {
+        return -1;
+    }
+    for (p_curFilter = p_format->filters
+            ; p_curFilter != NULL
+            ; p_curFilter = p_curFilter->p_next
+    ) {
+        FilterInfo **bucket = &table[p_curFilter->mHash & (size - 1)];
+        p_curFilter->p_hash_next = *bucket;
+        *bucket = p_curFilter;
+    }
+    free(p_format->filter_table);
+    p_format->filter_table = table;
+    p_format->filter_table_size = size;
+    return 0;
+}
 
 /*
  * Note: also accepts 0-9 priorities
@@ -164,17 +266,13 @@ static android_LogPriority filterPriForTag(
 {
     FilterInfo *p_curFilter;
 
-    for (p_curFilter = p_format->filters
-            ; p_curFilter != NULL
-            ; p_curFilter = p_curFilter->p_next
-    ) {
-        if (0 == strcmp(tag, p_curFilter->mTag)) {
-            if (p_curFilter->mPri == ANDROID_LOG_DEFAULT) {
-                return p_format->global_pri;
-            } else {
-                return p_curFilter->mPri;
-            }
-        }
+    if (!p_format->filter_count) {
+        return p_format->global_pri;
+    }
+
+    p_curFilter = filterFind(p_format, tag, filterHash(tag));
+    if (p_curFilter && (p_curFilter->mPri != ANDROID_LOG_DEFAULT)) {
+        return p_curFilter->mPri;
     }
 
     return p_format->global_pri;
@@ -208,6 +306,7 @@ LIBLOG_ABI_PUBLIC AndroidLogFormat *android_log_format_new()
     p_ret->epoch_output = false;
     p_ret->monotonic_output = android_log_clockid() == CLOCK_MONOTONIC;
     p_ret->uid_output = false;
+    p_ret->cached_time_len = 0;
 
     return p_ret;
 }
@@ -224,9 +323,10 @@ LIBLOG_ABI_PUBLIC void android_log_format_free(AndroidLogFormat *p_format)
         p_info_old = p_info;
         p_info = p_info->p_next;
 
-        free(p_info_old);
+        filterinfo_free(p_info_old);
     }
 
+    free(p_format->filter_table);
     free(p_format);
 
     /* Free conversion resource, can always be reconstructed */
@@ -241,6 +341,9 @@ LIBLOG_ABI_PUBLIC int android_log_setPrintFormat(
         AndroidLogFormat *p_format,
         AndroidLogPrintFormat format)
 {
+    /* Any modifier may change how the time stamp looks. */
+    p_format->cached_time_len = 0;
+
     switch (format) {
     case FORMAT_MODIFIER_COLOR:
         p_format->colored_output = true;
@@ -399,11 +502,32 @@ LIBLOG_ABI_PUBLIC int android_log_addFilterRule(
         tagName[tagNameLength] = '\0';
 #endif /*HAVE_STRNDUP*/
 
-        FilterInfo *p_fi = filterinfo_new(tagName, pri);
+        FilterInfo *p_fi = filterFind(p_format, tagName, filterHash(tagName));
+        if (p_fi) {
+            /* the latest rule for a tag wins */
+            p_fi->mPri = pri;
+            free(tagName);
+            return 0;
+        }
+
+        if (filterTableReserve(p_format, p_format->filter_count + 1) < 0) {
+            free(tagName);
+            goto error;
+        }
+        p_fi = filterinfo_new(tagName, pri);
         free(tagName);
+        if (!p_fi) {
+            goto error;
+        }
 
         p_fi->p_next = p_format->filters;
         p_format->filters = p_fi;
+
+        FilterInfo **bucket = &p_format->filter_table[
+                p_fi->mHash & (p_format->filter_table_size - 1)];
+        p_fi->p_hash_next = *bucket;
+        *bucket = p_fi;
+        ++p_format->filter_count;
     }
 
     return 0;
@@ -914,6 +1038,40 @@ LIBLOG_WEAK ssize_t utf8_character_length(const char *src, size_t len)
     return num_to_read;
 }
 
+/*
+ * Return the length of the leading run of characters that convertPrintable
+ * copies verbatim: ASCII from space onwards, except for backslash. Checks
+ * eight characters at a time while it can.
+ */
+static size_t printableRunLength(const char *message, size_t messageLen)
+{
+    static const uint64_t ones = 0x0101010101010101ULL;
+    static const uint64_t highs = 0x8080808080808080ULL;
+    size_t len = 0;
+
+    while ((messageLen - len) >= sizeof(uint64_t)) {
+        uint64_t v, backslash;
+
+        memcpy(&v, message + len, sizeof(v));
+        backslash = v ^ (ones * '\\');
+        if ((v & highs) /* non-ASCII */
+                || ((v - ones * ' ') & ~v & highs) /* control */
+                || ((backslash - ones) & ~backslash & highs)) {
+            break;
+        }
+        len += sizeof(uint64_t);
+    }
+    while (len < messageLen) {
+        unsigned char c = message[len];
+
+        if ((c < ' ') || (c & 0x80) || (c == '\\')) {
+            break;
+        }
+        ++len;
+    }
+    return len;
+}
+
 /*
  * Convert to printable from message to p buffer, return string length. If p is
  * NULL, do not copy, but still return the expected string length.
@@ -924,6 +1082,17 @@ static size_t convertPrintable(char *p, const char *message, size_t messageLen)
     bool print = p != NULL;
 
     while (messageLen) {
+        size_t run = printableRunLength(message, messageLen);
+        if (run) {
+            if (print) {
+                memcpy(p, message, run);
+            }
+            p += run;
+            message += run;
+            messageLen -= run;
+            continue;
+        }
+
         char buf[6];
         ssize_t len = sizeof(buf) - 1;
         if ((size_t)len > messageLen) {
@@ -971,6 +1140,9 @@ static size_t convertPrintable(char *p, const char *message, size_t messageLen)
         message += len;
         messageLen -= len;
     }
+    if (print) {
+        *p = '\0';
+    }
     return p - begin;
 }
 
@@ -1271,7 +1443,6 @@ LIBLOG_ABI_PUBLIC char *android_log_formatLogLine (
 #if !defined(_WIN32)
     struct tm tmBuf;
 #endif
-    struct tm* ptm;
     char timeBuf[64]; /* good margin, 23+nul for msec, 26+nul for usec */
     char prefixBuf[128], suffixBuf[128];
     char priChar;
@@ -1311,19 +1482,30 @@ LIBLOG_ABI_PUBLIC char *android_log_formatLogLine (
         nsec = NS_PER_SEC - nsec;
     }
     if (p_format->epoch_output || p_format->monotonic_output) {
-        ptm = NULL;
         snprintf(timeBuf, sizeof(timeBuf),
                  p_format->monotonic_output ? "%6lld" : "%19lld",
                  (long long)now);
     } else {
+        if (!p_format->cached_time_len || (p_format->cached_sec != now)) {
+            struct tm* ptm;
 #if !defined(_WIN32)
-        ptm = localtime_r(&now, &tmBuf);
+            ptm = localtime_r(&now, &tmBuf);
 #else
-        ptm = localtime(&now);
+            ptm = localtime(&now);
 #endif
-        strftime(timeBuf, sizeof(timeBuf),
-                 &"%Y-%m-%d %H:%M:%S"[p_format->year_output ? 0 : 3],
-                 ptm);
+            p_format->cached_time_len = strftime(
+                    p_format->cached_time, sizeof(p_format->cached_time),
+                    &"%Y-%m-%d %H:%M:%S"[p_format->year_output ? 0 : 3],
+                    ptm);
+            p_format->cached_zone[0] = '\0';
+            if (p_format->zone_output) {
+                strftime(p_format->cached_zone, sizeof(p_format->cached_zone),
+                         " %z", ptm);
+            }
+            p_format->cached_sec = now;
+        }
+        memcpy(timeBuf, p_format->cached_time, p_format->cached_time_len);
+        timeBuf[p_format->cached_time_len] = '\0';
     }
     len = strlen(timeBuf);
     if (p_format->usec_time_output) {
@@ -1333,8 +1515,10 @@ LIBLOG_ABI_PUBLIC char *android_log_formatLogLine (
         len += snprintf(timeBuf + len, sizeof(timeBuf) - len,
                         ".%03ld", nsec / MS_PER_NSEC);
     }
-    if (p_format->zone_output && ptm) {
-        strftime(timeBuf + len, sizeof(timeBuf) - len, " %z", ptm);
+    if (p_format->zone_output && !p_format->epoch_output
+            && !p_format->monotonic_output) {
+        snprintf(timeBuf + len, sizeof(timeBuf) - len, "%s",
+                 p_format->cached_zone);
     }
 
     /*
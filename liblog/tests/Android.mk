@@ -40,7 +40,10 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := $(test_module_prefix)benchmarks
 LOCAL_MODULE_TAGS := $(test_tags)
 LOCAL_CFLAGS += $(benchmark_c_flags)
-LOCAL_SHARED_LIBRARIES += liblog libm
+# bootstat's EventLogListBuilder, for comparison with EventEncoder
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../bootstat
+LOCAL_STATIC_LIBRARIES := libbootstat
+LOCAL_SHARED_LIBRARIES += liblog libm libbase
 LOCAL_SRC_FILES := $(benchmark_src_files)
 include $(BUILD_NATIVE_TEST)
 
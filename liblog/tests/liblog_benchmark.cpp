@@ -20,13 +20,20 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <cutils/sockets.h>
 #include <log/log.h>
+#include <log/log_event_encoder.h>
 #include <log/logger.h>
+#include <log/logprint.h>
 #include <log/log_read.h>
 #include <private/android_logger.h>
 
 #include "benchmark.h"
+#include "event_log_list_builder.h"
 
 // enhanced version of LOG_FAILURE_RETRY to add support for EAGAIN and
 // non-syscall libs. Since we are benchmarking, or using this in the emergency
@@ -688,3 +695,158 @@ static void BM_security(int iters) {
     StopBenchmarkTiming();
 }
 BENCHMARK(BM_security);
+
+/*
+ *	Record a dump of the main, system and crash buffers once, then measure
+ * the time it takes to process and format every entry as logcat does with
+ * the default threadtime format.
+ */
+static void BM_log_print_format(int iters) {
+    static std::vector<log_msg> dump;
+
+    if (dump.empty()) {
+        struct logger_list *logger_list = android_logger_list_alloc(
+            ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK, 0, 0);
+        if (!logger_list) {
+            fprintf(stderr, "Unable to open logs: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        android_logger_open(logger_list, LOG_ID_MAIN);
+        android_logger_open(logger_list, LOG_ID_SYSTEM);
+        android_logger_open(logger_list, LOG_ID_CRASH);
+
+        log_msg log_msg;
+        while (android_logger_list_read(logger_list, &log_msg) > 0) {
+            dump.push_back(log_msg);
+        }
+        android_logger_list_free(logger_list);
+
+        if (dump.empty()) {
+            fprintf(stderr, "No log entries to format\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    AndroidLogFormat *format = android_log_format_new();
+    android_log_setPrintFormat(format, FORMAT_THREADTIME);
+
+    uint64_t bytes = 0;
+    char buffer[1024];
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        log_msg &log_msg = dump[i % dump.size()];
+        AndroidLogEntry entry;
+        if (android_log_processLogBuffer(&log_msg.entry_v1, &entry) < 0) {
+            continue;
+        }
+        size_t len = 0;
+        char *line = android_log_formatLogLine(format, buffer, sizeof(buffer),
+                                               &entry, &len);
+        if (line != buffer) {
+            free(line);
+        }
+        bytes += len;
+    }
+
+    StopBenchmarkTiming();
+    SetBenchmarkBytesProcessed(bytes);
+
+    android_log_format_free(format);
+}
+BENCHMARK(BM_log_print_format);
+
+/*
+ *	Measure the cost of logging a fixed schema [int32, int32, string] event
+ * with each of the available event list encoders. The _write variants include
+ * the submission to logd, the _encode variants only build the payload.
+ */
+static const uint32_t BM_event_tag = 1005;
+static const std::string BM_event_string("com.android.example.package");
+
+static void BM_event_list_write(int iters) {
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        android_log_context ctx = create_android_logger(BM_event_tag);
+        android_log_write_int32(ctx, i);
+        android_log_write_int32(ctx, iters);
+        android_log_write_string8_len(ctx, BM_event_string.data(),
+                                      BM_event_string.size());
+        android_log_write_list(ctx, LOG_ID_EVENTS);
+        android_log_destroy(&ctx);
+    }
+
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_event_list_write);
+
+static void BM_event_list_builder_write(int iters) {
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        EventLogListBuilder builder;
+        builder.Append(i);
+        builder.Append(iters);
+        builder.Append(BM_event_string);
+
+        std::unique_ptr<uint8_t[]> log;
+        size_t size;
+        builder.Release(&log, &size);
+        __android_log_bwrite(BM_event_tag, log.get(), size);
+    }
+
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_event_list_builder_write);
+
+typedef android::EventEncoder<int32_t, int32_t, std::string> BM_event;
+
+static void BM_event_encoder_write(int iters) {
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        BM_event::write(BM_event_tag, i, iters, BM_event_string);
+    }
+
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_event_encoder_write);
+
+static void BM_event_list_builder_encode(int iters) {
+    uint64_t bytes = 0;
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        EventLogListBuilder builder;
+        builder.Append(i);
+        builder.Append(iters);
+        builder.Append(BM_event_string);
+
+        std::unique_ptr<uint8_t[]> log;
+        size_t size;
+        builder.Release(&log, &size);
+        bytes += size;
+    }
+
+    StopBenchmarkTiming();
+    SetBenchmarkBytesProcessed(bytes);
+}
+BENCHMARK(BM_event_list_builder_encode);
+
+static void BM_event_encoder_encode(int iters) {
+    uint8_t buf[BM_event::kMaxSize];
+    uint64_t bytes = 0;
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; ++i) {
+        bytes += BM_event::encode(buf, i, iters, BM_event_string);
+    }
+
+    StopBenchmarkTiming();
+    SetBenchmarkBytesProcessed(bytes);
+}
+BENCHMARK(BM_event_encoder_encode);
@@ -22,9 +22,13 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <string>
+
 #include <cutils/properties.h>
 #include <gtest/gtest.h>
+#include <log/event_tag_map.h>
 #include <log/log.h>
+#include <log/log_event_encoder.h>
 #include <log/logger.h>
 #include <log/log_read.h>
 #include <log/logprint.h>
@@ -1232,6 +1236,45 @@ TEST(liblog, filterRule) {
     android_log_format_free(p_format);
 }
 
+TEST(liblog, filterRule_many_tags) {
+    static const android_LogPriority pris[] = {
+        ANDROID_LOG_VERBOSE, ANDROID_LOG_DEBUG, ANDROID_LOG_INFO,
+        ANDROID_LOG_WARN, ANDROID_LOG_ERROR, ANDROID_LOG_FATAL
+    };
+    static const char priChars[] = "vdiwef";
+    static const size_t count = 1000;
+
+    AndroidLogFormat *p_format = android_log_format_new();
+
+    EXPECT_EQ(0, android_log_addFilterString(p_format, "*:s"));
+    for (size_t i = 0; i < count; ++i) {
+        char rule[32];
+        snprintf(rule, sizeof(rule), "tag%zu:%c", i, priChars[i % 6]);
+        EXPECT_EQ(0, android_log_addFilterRule(p_format, rule));
+    }
+
+    // a later rule for the same tag overrides the earlier one
+    EXPECT_EQ(0, android_log_addFilterString(p_format, "tag0:e tag1:w"));
+
+    for (size_t i = 0; i < count; ++i) {
+        char tag[32];
+        snprintf(tag, sizeof(tag), "tag%zu", i);
+        android_LogPriority pri = pris[i % 6];
+        if (i == 0) {
+            pri = ANDROID_LOG_ERROR;
+        } else if (i == 1) {
+            pri = ANDROID_LOG_WARN;
+        }
+        EXPECT_TRUE(checkPriForTag(p_format, tag, pri));
+    }
+
+    // unknown tags, including prefixes of known ones, use the global filter
+    EXPECT_TRUE(android_log_shouldPrintLine(p_format, "tag", ANDROID_LOG_FATAL) == 0);
+    EXPECT_TRUE(android_log_shouldPrintLine(p_format, "tag1000", ANDROID_LOG_FATAL) == 0);
+
+    android_log_format_free(p_format);
+}
+
 TEST(liblog, is_loggable) {
     static const char tag[] = "is_loggable";
     static const char log_namespace[] = "persist.log.tag.";
@@ -2465,6 +2508,78 @@ TEST(liblog, create_android_logger_overflow) {
     ASSERT_TRUE(NULL == ctx);
 }
 
+TEST(liblog, EventEncoder) {
+    char msgBuf[1024];
+    uint8_t buf[android::EventEncoder<int32_t, const char *>::kMaxSize];
+
+    // Fixed schemas need no more room than they use
+    EXPECT_EQ(5U, (android::EventEncoder<int32_t>::kMaxSize));
+    EXPECT_EQ(2U + 5 + 9 + 5,
+              (android::EventEncoder<int32_t, int64_t, float>::kMaxSize));
+
+    size_t len = android::EventEncoder<int32_t>::encode(buf, 42);
+    EXPECT_EQ(5U, len);
+    android_log_buffer_to_string((const char *)buf, len,
+                                 msgBuf, sizeof(msgBuf));
+    EXPECT_STREQ("42", msgBuf);
+
+    len = android::EventEncoder<int32_t, int64_t, const char *, std::string>::
+            encode(buf, -1, 0x100000000LL, "hello", std::string("world"));
+    android_log_buffer_to_string((const char *)buf, len,
+                                 msgBuf, sizeof(msgBuf));
+    EXPECT_STREQ("[-1,4294967296,hello,world]", msgBuf);
+
+    // Element by element, through the parser that readers use
+    android_log_context ctx = create_android_log_parser((const char *)buf, len);
+    ASSERT_TRUE(NULL != ctx);
+    android_log_list_element elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_LIST, elem.type);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_INT, elem.type);
+    EXPECT_EQ(-1, elem.data.int32);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_LONG, elem.type);
+    EXPECT_EQ(0x100000000LL, elem.data.int64);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_STRING, elem.type);
+    EXPECT_EQ("hello", std::string(elem.data.string, elem.len));
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_STRING, elem.type);
+    EXPECT_EQ("world", std::string(elem.data.string, elem.len));
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_LIST_STOP, elem.type);
+    EXPECT_TRUE(elem.complete);
+    EXPECT_LE(0, android_log_destroy(&ctx));
+
+    // Strings are truncated to keep the whole event in one entry
+    std::string big(LOGGER_ENTRY_MAX_PAYLOAD, 'x');
+    len = android::EventEncoder<int32_t, std::string>::encode(buf, 1, big);
+    EXPECT_EQ(LOGGER_ENTRY_MAX_PAYLOAD - sizeof(int32_t), len);
+    uint32_t strLen;
+    EXPECT_EQ(EVENT_TYPE_STRING, buf[2 + 5]);
+    memcpy(&strLen, &buf[2 + 5 + 1], sizeof(strLen));
+    EXPECT_EQ(len - (2 + 5 + 5), strLen);
+
+    // and the truncated string still parses as a whole element
+    ctx = create_android_log_parser((const char *)buf, len);
+    ASSERT_TRUE(NULL != ctx);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_LIST, elem.type);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_INT, elem.type);
+    EXPECT_EQ(1, elem.data.int32);
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_STRING, elem.type);
+    EXPECT_EQ(std::string(strLen, 'x'), std::string(elem.data.string, elem.len));
+    elem = android_log_read_next(ctx);
+    EXPECT_EQ(EVENT_TYPE_LIST_STOP, elem.type);
+    EXPECT_TRUE(elem.complete);
+    EXPECT_LE(0, android_log_destroy(&ctx));
+
+    EXPECT_LT(0, (android::EventEncoder<int32_t, const char *>::write(
+            1005, 1, "EventEncoder")));
+}
+
 static const char __pmsg_file[] =
         "/data/william-shakespeare/MuchAdoAboutNothing.txt";
 
@@ -2517,3 +2632,50 @@ TEST(liblog, __android_log_pmsg_file_read) {
     EXPECT_LT(0, ret);
     EXPECT_EQ(1U, signaled);
 }
+
+TEST(liblog, android_writeEventTagMapIndex) {
+    static const char copy[] = "/data/local/tmp/event-log-tags";
+    static const char index[] = "/data/local/tmp/event-log-tags" EVENT_TAG_MAP_INDEX_SUFFIX;
+    unlink(index);
+    std::string cmd = std::string("cp " EVENT_TAG_MAP_FILE " ") + copy;
+    ASSERT_EQ(0, system(cmd.c_str()));
+
+    // Without an index the text file is parsed, and nothing is written.
+    EventTagMap *map = android_openEventTagMap(copy);
+    ASSERT_TRUE(NULL != map);
+    EXPECT_NE(0, access(index, F_OK));
+
+    ASSERT_EQ(0, android_writeEventTagMapIndex(copy, index));
+
+    EventTagMap *indexed = android_openEventTagMap(copy);
+    ASSERT_TRUE(NULL != indexed);
+
+    for (int tag = 0; tag < 1000000; ++tag) {
+        const char *expected = android_lookupEventTag(map, tag);
+        const char *actual = android_lookupEventTag(indexed, tag);
+        if (expected) {
+            ASSERT_TRUE(NULL != actual);
+            EXPECT_STREQ(expected, actual);
+        } else {
+            EXPECT_TRUE(NULL == actual);
+        }
+    }
+    android_closeEventTagMap(indexed);
+
+    // A changed file ignores the stale index, even with the same size and
+    // modification time.
+    ASSERT_TRUE(NULL == android_lookupEventTag(map, 99));
+    cmd = std::string("sed -i 's/^42 /99 /' ") + copy +
+          " && touch -r " EVENT_TAG_MAP_FILE " " + copy;
+    ASSERT_EQ(0, system(cmd.c_str()));
+    indexed = android_openEventTagMap(copy);
+    ASSERT_TRUE(NULL != indexed);
+    EXPECT_TRUE(NULL == android_lookupEventTag(indexed, 42));
+    EXPECT_STREQ(android_lookupEventTag(map, 42),
+                 android_lookupEventTag(indexed, 99));
+    android_closeEventTagMap(indexed);
+
+    android_closeEventTagMap(map);
+    unlink(copy);
+    unlink(index);
+}
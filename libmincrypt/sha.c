@@ -25,9 +25,10 @@
 ** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-// Optimized for minimal code size.
+// Optimized for minimal code size, with optional hardware kernels.
 
 #include "mincrypt/sha.h"
+#include "sha_hw.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -35,54 +36,60 @@
 
 #define rol(bits, value) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
-static void SHA1_Transform(SHA_CTX* ctx) {
+static void SHA1_Transform(uint32_t* state, const uint8_t* p, size_t blocks) {
     uint32_t W[80];
     uint32_t A, B, C, D, E;
-    uint8_t* p = ctx->buf;
     int t;
 
-    for(t = 0; t < 16; ++t) {
-        uint32_t tmp =  *p++ << 24;
-        tmp |= *p++ << 16;
-        tmp |= *p++ << 8;
-        tmp |= *p++;
-        W[t] = tmp;
-    }
+    for (; blocks; --blocks) {
+        for(t = 0; t < 16; ++t) {
+            uint32_t tmp =  *p++ << 24;
+            tmp |= *p++ << 16;
+            tmp |= *p++ << 8;
+            tmp |= *p++;
+            W[t] = tmp;
+        }
 
-    for(; t < 80; t++) {
-        W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
-    }
+        for(; t < 80; t++) {
+            W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
+        }
+
+        A = state[0];
+        B = state[1];
+        C = state[2];
+        D = state[3];
+        E = state[4];
+
+        for(t = 0; t < 80; t++) {
+            uint32_t tmp = rol(5,A) + E + W[t];
+
+            if (t < 20)
+                tmp += (D^(B&(C^D))) + 0x5A827999;
+            else if ( t < 40)
+                tmp += (B^C^D) + 0x6ED9EBA1;
+            else if ( t < 60)
+                tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
+            else
+                tmp += (B^C^D) + 0xCA62C1D6;
+
+            E = D;
+            D = C;
+            C = rol(30,B);
+            B = A;
+            A = tmp;
+        }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
-
-    for(t = 0; t < 80; t++) {
-        uint32_t tmp = rol(5,A) + E + W[t];
-
-        if (t < 20)
-            tmp += (D^(B&(C^D))) + 0x5A827999;
-        else if ( t < 40)
-            tmp += (B^C^D) + 0x6ED9EBA1;
-        else if ( t < 60)
-            tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
-        else
-            tmp += (B^C^D) + 0xCA62C1D6;
-
-        E = D;
-        D = C;
-        C = rol(30,B);
-        B = A;
-        A = tmp;
+        state[0] += A;
+        state[1] += B;
+        state[2] += C;
+        state[3] += D;
+        state[4] += E;
     }
+}
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+static mincrypt_blocks_fn SHA1_blocks(void) {
+    mincrypt_blocks_fn fn = mincrypt_sha1_hw_blocks();
+    return fn ? fn : SHA1_Transform;
 }
 
 static const HASH_VTAB SHA_VTAB = {
@@ -105,34 +112,51 @@ void SHA_init(SHA_CTX* ctx) {
 
 
 void SHA_update(SHA_CTX* ctx, const void* data, int len) {
-    int i = (int) (ctx->count & 63);
+    mincrypt_blocks_fn blocks = SHA1_blocks();
+    size_t i = (size_t) (ctx->count & 63);
     const uint8_t* p = (const uint8_t*)data;
+    size_t n = len;
 
     ctx->count += len;
 
-    while (len--) {
-        ctx->buf[i++] = *p++;
-        if (i == 64) {
-            SHA1_Transform(ctx);
-            i = 0;
+    if (i) {
+        size_t fill = 64 - i;
+        if (n < fill) {
+            memcpy(ctx->buf + i, p, n);
+            return;
         }
+        memcpy(ctx->buf + i, p, fill);
+        blocks(ctx->state, ctx->buf, 1);
+        p += fill;
+        n -= fill;
     }
+
+    if (n >= 64) {
+        blocks(ctx->state, p, n / 64);
+        p += n & ~(size_t)63;
+        n &= 63;
+    }
+
+    memcpy(ctx->buf, p, n);
 }
 
 
 const uint8_t* SHA_final(SHA_CTX* ctx) {
     uint8_t *p = ctx->buf;
     uint64_t cnt = ctx->count * 8;
-    int i;
+    size_t i = (size_t) (ctx->count & 63);
 
-    SHA_update(ctx, (uint8_t*)"\x80", 1);
-    while ((ctx->count & 63) != 56) {
-        SHA_update(ctx, (uint8_t*)"\0", 1);
+    ctx->buf[i++] = 0x80;
+    if (i > 56) {
+        memset(ctx->buf + i, 0, 64 - i);
+        SHA1_blocks()(ctx->state, ctx->buf, 1);
+        i = 0;
     }
+    memset(ctx->buf + i, 0, 56 - i);
     for (i = 0; i < 8; ++i) {
-        uint8_t tmp = (uint8_t) (cnt >> ((7 - i) * 8));
-        SHA_update(ctx, &tmp, 1);
+        ctx->buf[56 + i] = (uint8_t) (cnt >> ((7 - i) * 8));
     }
+    SHA1_blocks()(ctx->state, ctx->buf, 1);
 
     for (i = 0; i < 5; i++) {
         uint32_t tmp = ctx->state[i];
@@ -25,9 +25,10 @@
 ** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-// Optimized for minimal code size.
+// Optimized for minimal code size, with optional hardware kernels.
 
 #include "mincrypt/sha256.h"
+#include "sha_hw.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -54,61 +55,67 @@ static const uint32_t K[64] = {
     0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
     0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
 
-static void SHA256_Transform(SHA256_CTX* ctx) {
+static void SHA256_Transform(uint32_t* state, const uint8_t* p, size_t blocks) {
     uint32_t W[64];
     uint32_t A, B, C, D, E, F, G, H;
-    uint8_t* p = ctx->buf;
     int t;
 
-    for(t = 0; t < 16; ++t) {
-        uint32_t tmp =  *p++ << 24;
-        tmp |= *p++ << 16;
-        tmp |= *p++ << 8;
-        tmp |= *p++;
-        W[t] = tmp;
-    }
+    for (; blocks; --blocks) {
+        for(t = 0; t < 16; ++t) {
+            uint32_t tmp =  *p++ << 24;
+            tmp |= *p++ << 16;
+            tmp |= *p++ << 8;
+            tmp |= *p++;
+            W[t] = tmp;
+        }
 
-    for(; t < 64; t++) {
-        uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
-        uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
-        W[t] = W[t-16] + s0 + W[t-7] + s1;
-    }
+        for(; t < 64; t++) {
+            uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
+            uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
+            W[t] = W[t-16] + s0 + W[t-7] + s1;
+        }
+
+        A = state[0];
+        B = state[1];
+        C = state[2];
+        D = state[3];
+        E = state[4];
+        F = state[5];
+        G = state[6];
+        H = state[7];
+
+        for(t = 0; t < 64; t++) {
+            uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
+            uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
+            uint32_t t2 = s0 + maj;
+            uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
+            uint32_t ch = (E & F) ^ ((~E) & G);
+            uint32_t t1 = H + s1 + ch + K[t] + W[t];
+
+            H = G;
+            G = F;
+            F = E;
+            E = D + t1;
+            D = C;
+            C = B;
+            B = A;
+            A = t1 + t2;
+        }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
-    F = ctx->state[5];
-    G = ctx->state[6];
-    H = ctx->state[7];
-
-    for(t = 0; t < 64; t++) {
-        uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
-        uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
-        uint32_t t2 = s0 + maj;
-        uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
-        uint32_t ch = (E & F) ^ ((~E) & G);
-        uint32_t t1 = H + s1 + ch + K[t] + W[t];
-
-        H = G;
-        G = F;
-        F = E;
-        E = D + t1;
-        D = C;
-        C = B;
-        B = A;
-        A = t1 + t2;
+        state[0] += A;
+        state[1] += B;
+        state[2] += C;
+        state[3] += D;
+        state[4] += E;
+        state[5] += F;
+        state[6] += G;
+        state[7] += H;
     }
+}
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
-    ctx->state[5] += F;
-    ctx->state[6] += G;
-    ctx->state[7] += H;
+static mincrypt_blocks_fn SHA256_blocks(void) {
+    mincrypt_blocks_fn fn = mincrypt_sha256_hw_blocks();
+    return fn ? fn : SHA256_Transform;
 }
 
 static const HASH_VTAB SHA256_VTAB = {
@@ -134,34 +141,51 @@ void SHA256_init(SHA256_CTX* ctx) {
 
 
 void SHA256_update(SHA256_CTX* ctx, const void* data, int len) {
-    int i = (int) (ctx->count & 63);
+    mincrypt_blocks_fn blocks = SHA256_blocks();
+    size_t i = (size_t) (ctx->count & 63);
     const uint8_t* p = (const uint8_t*)data;
+    size_t n = len;
 
     ctx->count += len;
 
-    while (len--) {
-        ctx->buf[i++] = *p++;
-        if (i == 64) {
-            SHA256_Transform(ctx);
-            i = 0;
+    if (i) {
+        size_t fill = 64 - i;
+        if (n < fill) {
+            memcpy(ctx->buf + i, p, n);
+            return;
         }
+        memcpy(ctx->buf + i, p, fill);
+        blocks(ctx->state, ctx->buf, 1);
+        p += fill;
+        n -= fill;
     }
+
+    if (n >= 64) {
+        blocks(ctx->state, p, n / 64);
+        p += n & ~(size_t)63;
+        n &= 63;
+    }
+
+    memcpy(ctx->buf, p, n);
 }
 
 
 const uint8_t* SHA256_final(SHA256_CTX* ctx) {
     uint8_t *p = ctx->buf;
     uint64_t cnt = ctx->count * 8;
-    int i;
+    size_t i = (size_t) (ctx->count & 63);
 
-    SHA256_update(ctx, (uint8_t*)"\x80", 1);
-    while ((ctx->count & 63) != 56) {
-        SHA256_update(ctx, (uint8_t*)"\0", 1);
+    ctx->buf[i++] = 0x80;
+    if (i > 56) {
+        memset(ctx->buf + i, 0, 64 - i);
+        SHA256_blocks()(ctx->state, ctx->buf, 1);
+        i = 0;
     }
+    memset(ctx->buf + i, 0, 56 - i);
     for (i = 0; i < 8; ++i) {
-        uint8_t tmp = (uint8_t) (cnt >> ((7 - i) * 8));
-        SHA256_update(ctx, &tmp, 1);
+        ctx->buf[56 + i] = (uint8_t) (cnt >> ((7 - i) * 8));
     }
+    SHA256_blocks()(ctx->state, ctx->buf, 1);
 
     for (i = 0; i < 8; i++) {
         uint32_t tmp = ctx->state[i];
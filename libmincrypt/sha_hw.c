@@ -0,0 +1,385 @@
+/* sha_hw.c
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of Google Inc. nor the names of its contributors may
+**       be used to endorse or promote products derived from this software
+**       without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+** MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+** EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// SHA-1 and SHA-256 block functions using the SHA instructions of the CPU.
+// The choice is made at runtime, sha.c and sha256.c fall back to their
+// portable code when these return NULL.
+
+#include "sha_hw.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (__GNUC__ >= 5))
+#define MINCRYPT_SHA_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO) && defined(__linux__)
+#define MINCRYPT_SHA_ARMV8 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+#if defined(MINCRYPT_SHA_X86) || defined(MINCRYPT_SHA_ARMV8)
+static const uint32_t K256[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+#endif
+
+#if defined(MINCRYPT_SHA_X86)
+
+#define SHA_X86_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+// Four SHA-1 rounds 4*g .. 4*g+3. E[g&1] carries E into these rounds and
+// E[~g&1] receives it for the next ones; MSG[g&3] holds their schedule.
+#define SHA1_X86_ROUNDS(g)                                                   \
+    do {                                                                     \
+        if ((g) == 0)                                                        \
+            E[0] = _mm_add_epi32(E[0], MSG[0]);                              \
+        else                                                                 \
+            E[(g) & 1] = _mm_sha1nexte_epu32(E[(g) & 1], MSG[(g) & 3]);      \
+        E[~(g) & 1] = ABCD;                                                  \
+        if ((g) >= 3 && (g) <= 18)                                           \
+            MSG[((g) + 1) & 3] = _mm_sha1msg2_epu32(MSG[((g) + 1) & 3],      \
+                                                    MSG[(g) & 3]);           \
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E[(g) & 1], (g) / 5);               \
+        if ((g) >= 1 && (g) <= 16)                                           \
+            MSG[((g) - 1) & 3] = _mm_sha1msg1_epu32(MSG[((g) - 1) & 3],      \
+                                                    MSG[(g) & 3]);           \
+        if ((g) >= 2 && (g) <= 17)                                           \
+            MSG[((g) - 2) & 3] = _mm_xor_si128(MSG[((g) - 2) & 3],           \
+                                               MSG[(g) & 3]);                \
+    } while (0)
+
+SHA_X86_TARGET
+static void SHA1_Transform_x86(uint32_t* state, const uint8_t* data,
+                               size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i ABCD, ABCD_SAVE, E_SAVE;
+    __m128i E[2], MSG[4];
+    int i;
+
+    ABCD = _mm_loadu_si128((const __m128i*) state);
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+    E[0] = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; blocks; --blocks, data += 64) {
+        ABCD_SAVE = ABCD;
+        E_SAVE = E[0];
+
+        for (i = 0; i < 4; ++i) {
+            MSG[i] = _mm_loadu_si128((const __m128i*) (data + 16 * i));
+            MSG[i] = _mm_shuffle_epi8(MSG[i], MASK);
+        }
+
+        SHA1_X86_ROUNDS(0);  SHA1_X86_ROUNDS(1);
+        SHA1_X86_ROUNDS(2);  SHA1_X86_ROUNDS(3);
+        SHA1_X86_ROUNDS(4);  SHA1_X86_ROUNDS(5);
+        SHA1_X86_ROUNDS(6);  SHA1_X86_ROUNDS(7);
+        SHA1_X86_ROUNDS(8);  SHA1_X86_ROUNDS(9);
+        SHA1_X86_ROUNDS(10); SHA1_X86_ROUNDS(11);
+        SHA1_X86_ROUNDS(12); SHA1_X86_ROUNDS(13);
+        SHA1_X86_ROUNDS(14); SHA1_X86_ROUNDS(15);
+        SHA1_X86_ROUNDS(16); SHA1_X86_ROUNDS(17);
+        SHA1_X86_ROUNDS(18); SHA1_X86_ROUNDS(19);
+
+        E[0] = _mm_sha1nexte_epu32(E[0], E_SAVE);
+        ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+    }
+
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+    _mm_storeu_si128((__m128i*) state, ABCD);
+    state[4] = _mm_extract_epi32(E[0], 3);
+}
+
+// Four SHA-256 rounds 4*g .. 4*g+3 with their schedule in MSG[g&3].
+#define SHA256_X86_ROUNDS(g)                                                 \
+    do {                                                                     \
+        __m128i msg = _mm_add_epi32(MSG[(g) & 3],                            \
+            _mm_load_si128((const __m128i*) &K256[4 * (g)]));                \
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, msg);                 \
+        if ((g) >= 3 && (g) <= 14) {                                         \
+            __m128i tmp = _mm_alignr_epi8(MSG[(g) & 3],                      \
+                                          MSG[((g) - 1) & 3], 4);            \
+            MSG[((g) + 1) & 3] = _mm_add_epi32(MSG[((g) + 1) & 3], tmp);     \
+            MSG[((g) + 1) & 3] = _mm_sha256msg2_epu32(MSG[((g) + 1) & 3],    \
+                                                      MSG[(g) & 3]);         \
+        }                                                                    \
+        msg = _mm_shuffle_epi32(msg, 0x0E);                                  \
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, msg);                 \
+        if ((g) >= 1 && (g) <= 12)                                           \
+            MSG[((g) - 1) & 3] = _mm_sha256msg1_epu32(MSG[((g) - 1) & 3],    \
+                                                      MSG[(g) & 3]);         \
+    } while (0)
+
+SHA_X86_TARGET
+static void SHA256_Transform_x86(uint32_t* state, const uint8_t* data,
+                                 size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, TMP;
+    __m128i MSG[4];
+    int i;
+
+    TMP = _mm_loadu_si128((const __m128i*) &state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i*) &state[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xB1);            // CDAB
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);      // EFGH
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);      // ABEF
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);   // CDGH
+
+    for (; blocks; --blocks, data += 64) {
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        for (i = 0; i < 4; ++i) {
+            MSG[i] = _mm_loadu_si128((const __m128i*) (data + 16 * i));
+            MSG[i] = _mm_shuffle_epi8(MSG[i], MASK);
+        }
+
+        SHA256_X86_ROUNDS(0);  SHA256_X86_ROUNDS(1);
+        SHA256_X86_ROUNDS(2);  SHA256_X86_ROUNDS(3);
+        SHA256_X86_ROUNDS(4);  SHA256_X86_ROUNDS(5);
+        SHA256_X86_ROUNDS(6);  SHA256_X86_ROUNDS(7);
+        SHA256_X86_ROUNDS(8);  SHA256_X86_ROUNDS(9);
+        SHA256_X86_ROUNDS(10); SHA256_X86_ROUNDS(11);
+        SHA256_X86_ROUNDS(12); SHA256_X86_ROUNDS(13);
+        SHA256_X86_ROUNDS(14); SHA256_X86_ROUNDS(15);
+
+        STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+        STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+    }
+
+    TMP = _mm_shuffle_epi32(STATE0, 0x1B);         // FEBA
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);      // DCHG
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);   // DCBA
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);      // ABEF
+
+    _mm_storeu_si128((__m128i*) &state[0], STATE0);
+    _mm_storeu_si128((__m128i*) &state[4], STATE1);
+}
+
+static int cpu_has_sha(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) {
+        return 0;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1 << 29)) != 0;  // SHA
+}
+
+#define SHA1_HW_TRANSFORM SHA1_Transform_x86
+#define SHA256_HW_TRANSFORM SHA256_Transform_x86
+#define cpu_has_sha1 cpu_has_sha
+#define cpu_has_sha256 cpu_has_sha
+
+#elif defined(MINCRYPT_SHA_ARMV8)
+
+// Four SHA-1 rounds 4*g .. 4*g+3. E[g&1] carries E into these rounds and
+// E[~g&1] receives it for the next ones; TMP[g&1] holds W + K for them.
+#define SHA1_ARMV8_ROUNDS(g, op)                                             \
+    do {                                                                     \
+        E[~(g) & 1] = vsha1h_u32(vgetq_lane_u32(ABCD, 0));                   \
+        ABCD = op(ABCD, E[(g) & 1], TMP[(g) & 1]);                           \
+        if ((g) < 18)                                                        \
+            TMP[(g) & 1] = vaddq_u32(MSG[((g) + 2) & 3],                     \
+                                     vdupq_n_u32(K1[((g) + 2) / 5]));        \
+        if ((g) >= 1 && (g) <= 16)                                           \
+            MSG[((g) - 1) & 3] = vsha1su1q_u32(MSG[((g) - 1) & 3],           \
+                                               MSG[((g) + 2) & 3]);          \
+        if ((g) <= 15)                                                       \
+            MSG[(g) & 3] = vsha1su0q_u32(MSG[(g) & 3], MSG[((g) + 1) & 3],   \
+                                         MSG[((g) + 2) & 3]);                \
+    } while (0)
+
+static void SHA1_Transform_armv8(uint32_t* state, const uint8_t* data,
+                                 size_t blocks) {
+    static const uint32_t K1[4] = {
+        0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+    uint32x4_t ABCD, ABCD_SAVE;
+    uint32x4_t TMP[2], MSG[4];
+    uint32_t E[2], E_SAVE;
+    int i;
+
+    ABCD = vld1q_u32(&state[0]);
+    E[0] = state[4];
+
+    for (; blocks; --blocks, data += 64) {
+        ABCD_SAVE = ABCD;
+        E_SAVE = E[0];
+
+        for (i = 0; i < 4; ++i) {
+            MSG[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+        TMP[0] = vaddq_u32(MSG[0], vdupq_n_u32(K1[0]));
+        TMP[1] = vaddq_u32(MSG[1], vdupq_n_u32(K1[0]));
+
+        SHA1_ARMV8_ROUNDS(0, vsha1cq_u32);  SHA1_ARMV8_ROUNDS(1, vsha1cq_u32);
+        SHA1_ARMV8_ROUNDS(2, vsha1cq_u32);  SHA1_ARMV8_ROUNDS(3, vsha1cq_u32);
+        SHA1_ARMV8_ROUNDS(4, vsha1cq_u32);  SHA1_ARMV8_ROUNDS(5, vsha1pq_u32);
+        SHA1_ARMV8_ROUNDS(6, vsha1pq_u32);  SHA1_ARMV8_ROUNDS(7, vsha1pq_u32);
+        SHA1_ARMV8_ROUNDS(8, vsha1pq_u32);  SHA1_ARMV8_ROUNDS(9, vsha1pq_u32);
+        SHA1_ARMV8_ROUNDS(10, vsha1mq_u32); SHA1_ARMV8_ROUNDS(11, vsha1mq_u32);
+        SHA1_ARMV8_ROUNDS(12, vsha1mq_u32); SHA1_ARMV8_ROUNDS(13, vsha1mq_u32);
+        SHA1_ARMV8_ROUNDS(14, vsha1mq_u32); SHA1_ARMV8_ROUNDS(15, vsha1pq_u32);
+        SHA1_ARMV8_ROUNDS(16, vsha1pq_u32); SHA1_ARMV8_ROUNDS(17, vsha1pq_u32);
+        SHA1_ARMV8_ROUNDS(18, vsha1pq_u32); SHA1_ARMV8_ROUNDS(19, vsha1pq_u32);
+
+        E[0] += E_SAVE;
+        ABCD = vaddq_u32(ABCD, ABCD_SAVE);
+    }
+
+    vst1q_u32(&state[0], ABCD);
+    state[4] = E[0];
+}
+
+// Four SHA-256 rounds 4*g .. 4*g+3; TMP[g&1] holds W + K for them.
+#define SHA256_ARMV8_ROUNDS(g)                                               \
+    do {                                                                     \
+        uint32x4_t save = STATE0;                                            \
+        if ((g) < 12)                                                        \
+            MSG[(g) & 3] = vsha256su0q_u32(MSG[(g) & 3], MSG[((g) + 1) & 3]);\
+        if ((g) < 15)                                                        \
+            TMP[~(g) & 1] = vaddq_u32(MSG[((g) + 1) & 3],                    \
+                                      vld1q_u32(&K256[4 * ((g) + 1)]));      \
+        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP[(g) & 1]);                \
+        STATE1 = vsha256h2q_u32(STATE1, save, TMP[(g) & 1]);                 \
+        if ((g) < 12)                                                        \
+            MSG[(g) & 3] = vsha256su1q_u32(MSG[(g) & 3], MSG[((g) + 2) & 3], \
+                                           MSG[((g) + 3) & 3]);              \
+    } while (0)
+
+static void SHA256_Transform_armv8(uint32_t* state, const uint8_t* data,
+                                   size_t blocks) {
+    uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+    uint32x4_t TMP[2], MSG[4];
+    int i;
+
+    STATE0 = vld1q_u32(&state[0]);
+    STATE1 = vld1q_u32(&state[4]);
+
+    for (; blocks; --blocks, data += 64) {
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        for (i = 0; i < 4; ++i) {
+            MSG[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+        TMP[0] = vaddq_u32(MSG[0], vld1q_u32(&K256[0]));
+
+        SHA256_ARMV8_ROUNDS(0);  SHA256_ARMV8_ROUNDS(1);
+        SHA256_ARMV8_ROUNDS(2);  SHA256_ARMV8_ROUNDS(3);
+        SHA256_ARMV8_ROUNDS(4);  SHA256_ARMV8_ROUNDS(5);
+        SHA256_ARMV8_ROUNDS(6);  SHA256_ARMV8_ROUNDS(7);
+        SHA256_ARMV8_ROUNDS(8);  SHA256_ARMV8_ROUNDS(9);
+        SHA256_ARMV8_ROUNDS(10); SHA256_ARMV8_ROUNDS(11);
+        SHA256_ARMV8_ROUNDS(12); SHA256_ARMV8_ROUNDS(13);
+        SHA256_ARMV8_ROUNDS(14); SHA256_ARMV8_ROUNDS(15);
+
+        STATE0 = vaddq_u32(STATE0, ABEF_SAVE);
+        STATE1 = vaddq_u32(STATE1, CDGH_SAVE);
+    }
+
+    vst1q_u32(&state[0], STATE0);
+    vst1q_u32(&state[4], STATE1);
+}
+
+static int cpu_has_sha1(void) {
+    return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+}
+
+static int cpu_has_sha256(void) {
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+
+#define SHA1_HW_TRANSFORM SHA1_Transform_armv8
+#define SHA256_HW_TRANSFORM SHA256_Transform_armv8
+
+#endif
+
+static int sha_hw_enabled = 1;
+
+void mincrypt_sha_hw_enable(int enable) {
+    sha_hw_enabled = enable;
+}
+
+#if defined(SHA1_HW_TRANSFORM)
+
+// -1 until the CPU has been checked. Checking again from several threads
+// at once is harmless, they all store the same answer.
+static volatile int sha1_hw_available = -1;
+static volatile int sha256_hw_available = -1;
+
+mincrypt_blocks_fn mincrypt_sha1_hw_blocks(void) {
+    if (sha1_hw_available < 0) {
+        sha1_hw_available = cpu_has_sha1();
+    }
+    return (sha_hw_enabled && sha1_hw_available) ? SHA1_HW_TRANSFORM : NULL;
+}
+
+mincrypt_blocks_fn mincrypt_sha256_hw_blocks(void) {
+    if (sha256_hw_available < 0) {
+        sha256_hw_available = cpu_has_sha256();
+    }
+    return (sha_hw_enabled && sha256_hw_available) ? SHA256_HW_TRANSFORM : NULL;
+}
+
+#else
+
+mincrypt_blocks_fn mincrypt_sha1_hw_blocks(void) {
+    return NULL;
+}
+
+mincrypt_blocks_fn mincrypt_sha256_hw_blocks(void) {
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/* sha_hw.h
+**
+** Copyright 2016, The Android Open Source Project
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of Google Inc. nor the names of its contributors may
+**       be used to endorse or promote products derived from this software
+**       without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+** MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+** EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
+#define SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Compresses "blocks" consecutive 64-byte blocks at "data" into "state".
+typedef void (*mincrypt_blocks_fn)(uint32_t* state, const uint8_t* data,
+                                   size_t blocks);
+
+// Return the SHA-1 or SHA-256 kernel using the CPU's SHA instructions
+// (SHA-NI on x86, the crypto extensions on ARMv8), or NULL when the CPU
+// does not have them or they have been disabled.
+mincrypt_blocks_fn mincrypt_sha1_hw_blocks(void);
+mincrypt_blocks_fn mincrypt_sha256_hw_blocks(void);
+
+// Turns the hardware kernels off (0) or back on (1). For tests and
+// benchmarks comparing against the portable code.
+void mincrypt_sha_hw_enable(int enable);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif  // SYSTEM_CORE_LIBMINCRYPT_SHA_HW_H_
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google Inc. nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+
+// Reports SHA-1 and SHA-256 throughput for several buffer sizes, with the
+// hardware kernels (when the CPU has them) and with the portable code.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include <time.h>
+
+#include "mincrypt/sha.h"
+#include "mincrypt/sha256.h"
+#include "../sha_hw.h"
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+
+#define TOTAL_BYTES (64 * 1024 * 1024)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef const uint8_t* (*hash_fn)(const void*, int, uint8_t*);
+
+static void run(const char* name, hash_fn hash, const uint8_t* data, int size) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    int i, iterations = TOTAL_BYTES / size;
+    double start, elapsed;
+
+    start = now();
+    for (i = 0; i < iterations; ++i) {
+        hash(data, size, digest);
+    }
+    elapsed = now() - start;
+
+    printf("%-8s %8d bytes %10.1f MB/s\n", name, size,
+           (double) iterations * size / elapsed / (1024 * 1024));
+}
+
+int main(int arg __unused, char** argv __unused) {
+    static const int sizes[] = { 64, 1024, 4096, 1024 * 1024 };
+    uint8_t* data = malloc(sizes[3]);
+    size_t i;
+    int hw;
+
+    if (!data) {
+        return 1;
+    }
+    for (i = 0; i < (size_t) sizes[3]; ++i) {
+        data[i] = i;
+    }
+
+    for (hw = 1; hw >= 0; --hw) {
+        mincrypt_sha_hw_enable(hw);
+        printf("SHA-1 %s, SHA-256 %s\n",
+               mincrypt_sha1_hw_blocks() ? "hardware" : "portable",
+               mincrypt_sha256_hw_blocks() ? "hardware" : "portable");
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            run("SHA-1", SHA_hash, data, sizes[i]);
+            run("SHA-256", SHA256_hash, data, sizes[i]);
+        }
+        printf("\n");
+    }
+
+    free(data);
+    return 0;
+}
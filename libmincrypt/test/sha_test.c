@@ -0,0 +1,166 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google Inc. nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Google Inc. ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL Google Inc. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+
+#include "mincrypt/sha.h"
+#include "mincrypt/sha256.h"
+#include "../sha_hw.h"
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+
+// Test vectors from FIPS 180-2 and the NIST example values.
+static const struct {
+    const char* message;
+    int repeat;
+    const char* sha1;
+    const char* sha256;
+} vectors[] = {
+    { "", 1,
+      "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1,
+      "a9993e364706816aba3e25717850c26c9cd0d89d",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "a", 1000000,
+      "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    { "0123456701234567012345670123456701234567012345670123456701234567", 10,
+      "dea356a2cddd90c7a7ecedc5ebb563934f460452",
+      "594847328451bdfa85056225462cc1d867d877fb388df0ce35f25ab5562bfbb5" },
+};
+
+static void tohex(const uint8_t* digest, int len, char* out) {
+    int i;
+    for (i = 0; i < len; ++i) {
+        sprintf(out + 2 * i, "%02x", digest[i]);
+    }
+}
+
+// Hashes the vector, feeding the repeated message in odd sized chunks to
+// exercise the partial block handling.
+static int check_vector(int n) {
+    const char* message = vectors[n].message;
+    int len = strlen(message);
+    SHA_CTX sha;
+    SHA256_CTX sha256;
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    int i, success = 1;
+
+    SHA_init(&sha);
+    SHA256_init(&sha256);
+    for (i = 0; i < vectors[n].repeat; ++i) {
+        int done = 0;
+        while (done < len) {
+            int chunk = (i % 7) + 1;
+            if (chunk > len - done) {
+                chunk = len - done;
+            }
+            SHA_update(&sha, message + done, chunk);
+            SHA256_update(&sha256, message + done, chunk);
+            done += chunk;
+        }
+    }
+
+    tohex(SHA_final(&sha), SHA_DIGEST_SIZE, hex);
+    if (strcmp(hex, vectors[n].sha1)) {
+        printf("vector %d: SHA-1 %s, expected %s\n", n, hex, vectors[n].sha1);
+        success = 0;
+    }
+    tohex(SHA256_final(&sha256), SHA256_DIGEST_SIZE, hex);
+    if (strcmp(hex, vectors[n].sha256)) {
+        printf("vector %d: SHA-256 %s, expected %s\n", n, hex, vectors[n].sha256);
+        success = 0;
+    }
+    return success;
+}
+
+// Compares the hardware kernels, if any, against the portable code on
+// pseudo-random messages of every length up to a few blocks.
+static int check_hw_matches_portable(void) {
+    uint8_t message[1024];
+    uint8_t digest[2][SHA256_DIGEST_SIZE];
+    int len, i, success = 1;
+
+    srand(1);
+    for (i = 0; i < (int) sizeof(message); ++i) {
+        message[i] = rand();
+    }
+
+    for (len = 0; len <= (int) sizeof(message); ++len) {
+        for (i = 0; i < 2; ++i) {
+            mincrypt_sha_hw_enable(i);
+            SHA_hash(message, len, digest[i]);
+        }
+        if (memcmp(digest[0], digest[1], SHA_DIGEST_SIZE)) {
+            printf("SHA-1 hardware mismatch at length %d\n", len);
+            success = 0;
+        }
+        for (i = 0; i < 2; ++i) {
+            mincrypt_sha_hw_enable(i);
+            SHA256_hash(message, len, digest[i]);
+        }
+        if (memcmp(digest[0], digest[1], SHA256_DIGEST_SIZE)) {
+            printf("SHA-256 hardware mismatch at length %d\n", len);
+            success = 0;
+        }
+    }
+    mincrypt_sha_hw_enable(1);
+    return success;
+}
+
+int main(int arg __unused, char** argv __unused) {
+    int success = 1;
+    int hw;
+    size_t n;
+
+    for (hw = 1; hw >= 0; --hw) {
+        mincrypt_sha_hw_enable(hw);
+        printf("SHA-1 %s, SHA-256 %s\n",
+               mincrypt_sha1_hw_blocks() ? "hardware" : "portable",
+               mincrypt_sha256_hw_blocks() ? "hardware" : "portable");
+        for (n = 0; n < sizeof(vectors) / sizeof(vectors[0]); ++n) {
+            success = check_vector(n) && success;
+        }
+    }
+    mincrypt_sha_hw_enable(1);
+
+    success = check_hw_matches_portable() && success;
+
+    printf("\n%s\n\n", success ? "PASS" : "FAIL");
+
+    return !success;
+}
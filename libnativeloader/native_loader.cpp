@@ -26,9 +26,13 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "android-base/file.h"
 #include "android-base/macros.h"
@@ -45,12 +49,73 @@ static constexpr const char* kPublicNativeLibrariesVendorConfig = "/vendor/etc/p
 // This list includes all directories app is allowed to access this way.
 static constexpr const char* kWhitelistedDirectories = "/data:/mnt/expand";
 
+// Number of threads used to preload the public native libraries. Values
+// less than 2 keep the historical serial preload.
+static constexpr const char* kPreloadThreadsProperty = "ro.nativeloader.preload_threads";
+static constexpr size_t kMaxPreloadThreads = 8;
+
 static bool is_debuggable() {
   char debuggable[PROP_VALUE_MAX];
   property_get("ro.debuggable", debuggable, "0");
   return std::string(debuggable) == "1";
 }
 
+static size_t preload_thread_count() {
+  char value[PROP_VALUE_MAX];
+  property_get(kPreloadThreadsProperty, value, "0");
+  int count = atoi(value);
+  if (count < 1) {
+    return 1;
+  }
+  return std::min(static_cast<size_t>(count), kMaxPreloadThreads);
+}
+
+static void preload_public_libraries(const std::vector<std::string>& sonames) {
+  size_t thread_count = std::min(preload_thread_count(), sonames.size());
+  if (thread_count < 2) {
+    for (const auto& soname : sonames) {
+      dlopen(soname.c_str(), RTLD_NOW | RTLD_NODELETE);
+    }
+    return;
+  }
+
+  // Every worker claims the next library from a shared index so that one
+  // slow library does not hold back a statically assigned slice of the list.
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < sonames.size(); i = next++) {
+      dlopen(sonames[i].c_str(), RTLD_NOW | RTLD_NODELETE);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Returns System.identityHashCode(object). The hash is stable for the lifetime
+// of the object, which makes it usable as a key for the weak references we keep
+// to class loaders.
+static jint identity_hash_code(JNIEnv* env, jobject object) {
+  static std::once_flag once;
+  static jclass system_class;
+  static jmethodID identity_hash_code_method;
+  std::call_once(once, [env]() {
+    jclass local_class = env->FindClass("java/lang/System");
+    system_class = reinterpret_cast<jclass>(env->NewGlobalRef(local_class));
+    env->DeleteLocalRef(local_class);
+    identity_hash_code_method = env->GetStaticMethodID(system_class,
+                                                       "identityHashCode",
+                                                       "(Ljava/lang/Object;)I");
+  });
+  return env->CallStaticIntMethod(system_class, identity_hash_code_method, object);
+}
+
 class LibraryNamespaces {
  public:
   LibraryNamespaces() : initialized_(false) { }
@@ -106,18 +171,26 @@ class LibraryNamespaces {
                                   parent_ns);
 
     if (ns != nullptr) {
-      namespaces_.push_back(std::make_pair(env->NewWeakGlobalRef(class_loader), ns));
+      namespaces_[identity_hash_code(env, class_loader)].push_back(
+          std::make_pair(env->NewWeakGlobalRef(class_loader), ns));
     }
 
     return ns;
   }
 
   android_namespace_t* FindNamespaceByClassLoader(JNIEnv* env, jobject class_loader) {
-    auto it = std::find_if(namespaces_.begin(), namespaces_.end(),
+    auto bucket = namespaces_.find(identity_hash_code(env, class_loader));
+    if (bucket == namespaces_.end()) {
+      return nullptr;
+    }
+
+    // Identity hash codes are not unique, so the bucket still has to be
+    // checked with IsSameObject.
+    auto it = std::find_if(bucket->second.begin(), bucket->second.end(),
                 [&](const std::pair<jweak, android_namespace_t*>& value) {
                   return env->IsSameObject(value.first, class_loader);
                 });
-    return it != namespaces_.end() ? it->second : nullptr;
+    return it != bucket->second.end() ? it->second : nullptr;
   }
 
   void Initialize() {
@@ -155,9 +228,7 @@ class LibraryNamespaces {
     // we might as well end up loading them from /system/lib
     // For now we rely on CTS test to catch things like this but
     // it should probably be addressed in the future.
-    for (const auto& soname : sonames) {
-      dlopen(soname.c_str(), RTLD_NOW | RTLD_NODELETE);
-    }
+    preload_public_libraries(sonames);
 
     public_libraries_ = base::Join(sonames, ':');
   }
@@ -244,27 +315,30 @@ class LibraryNamespaces {
   }
 
   bool initialized_;
-  std::vector<std::pair<jweak, android_namespace_t*>> namespaces_;
+  // Namespaces keyed by the identity hash code of their class loader.
+  std::unordered_map<jint, std::vector<std::pair<jweak, android_namespace_t*>>> namespaces_;
   std::string public_libraries_;
 
 
   DISALLOW_COPY_AND_ASSIGN(LibraryNamespaces);
 };
 
-static std::mutex g_namespaces_mutex;
+// Lookups by class loader only need shared access; creating namespaces and
+// (re)initialization take the lock exclusively.
+static std::shared_timed_mutex g_namespaces_mutex;
 static LibraryNamespaces* g_namespaces = new LibraryNamespaces;
 #endif
 
 void InitializeNativeLoader() {
 #if defined(__ANDROID__)
-  std::lock_guard<std::mutex> guard(g_namespaces_mutex);
+  std::lock_guard<std::shared_timed_mutex> guard(g_namespaces_mutex);
   g_namespaces->Initialize();
 #endif
 }
 
 void ResetNativeLoader() {
 #if defined(__ANDROID__)
-  std::lock_guard<std::mutex> guard(g_namespaces_mutex);
+  std::lock_guard<std::shared_timed_mutex> guard(g_namespaces_mutex);
   g_namespaces->Reset();
 #endif
 }
@@ -277,7 +351,7 @@ jstring CreateClassLoaderNamespace(JNIEnv* env,
                                    jstring permitted_path) {
 #if defined(__ANDROID__)
   UNUSED(target_sdk_version);
-  std::lock_guard<std::mutex> guard(g_namespaces_mutex);
+  std::lock_guard<std::shared_timed_mutex> guard(g_namespaces_mutex);
   android_namespace_t* ns = g_namespaces->Create(env,
                                                  class_loader,
                                                  is_shared,
@@ -304,15 +378,24 @@ void* OpenNativeLibrary(JNIEnv* env,
     return dlopen(path, RTLD_NOW);
   }
 
-  std::lock_guard<std::mutex> guard(g_namespaces_mutex);
-  android_namespace_t* ns = g_namespaces->FindNamespaceByClassLoader(env, class_loader);
+  android_namespace_t* ns;
+  {
+    std::shared_lock<std::shared_timed_mutex> guard(g_namespaces_mutex);
+    ns = g_namespaces->FindNamespaceByClassLoader(env, class_loader);
+  }
 
   if (ns == nullptr) {
-    // This is the case where the classloader was not created by ApplicationLoaders
-    // In this case we create an isolated not-shared namespace for it.
-    ns = g_namespaces->Create(env, class_loader, false, library_path, nullptr);
+    std::lock_guard<std::shared_timed_mutex> guard(g_namespaces_mutex);
+    // Another thread may have created the namespace while we were not
+    // holding the lock, so check again before creating it.
+    ns = g_namespaces->FindNamespaceByClassLoader(env, class_loader);
     if (ns == nullptr) {
-      return nullptr;
+      // This is the case where the classloader was not created by ApplicationLoaders
+      // In this case we create an isolated not-shared namespace for it.
+      ns = g_namespaces->Create(env, class_loader, false, library_path, nullptr);
+      if (ns == nullptr) {
+        return nullptr;
+      }
     }
   }
 
@@ -333,7 +416,7 @@ bool CloseNativeLibrary(void* handle) {
 
 #if defined(__ANDROID__)
 android_namespace_t* FindNamespaceByClassLoader(JNIEnv* env, jobject class_loader) {
-  std::lock_guard<std::mutex> guard(g_namespaces_mutex);
+  std::shared_lock<std::shared_timed_mutex> guard(g_namespaces_mutex);
   return g_namespaces->FindNamespaceByClassLoader(env, class_loader);
 }
 #endif
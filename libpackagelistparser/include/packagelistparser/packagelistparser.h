@@ -87,6 +87,89 @@ extern bool packagelist_parse(pfn_on_package callback, void *userdata);
  */
 extern void packagelist_free(pkg_info *info);
 
+typedef struct pkg_str pkg_str;
+typedef struct pkg_entry pkg_entry;
+typedef struct packagelist packagelist;
+
+/**
+ * A view into a mapped packages list. The data is NOT NUL terminated and is
+ * only valid until the owning packagelist is unmapped.
+ */
+struct pkg_str {
+    const char *data;
+    size_t len;
+};
+
+struct pkg_entry {
+    pkg_str name;
+    uid_t uid;
+    bool debuggable;
+    pkg_str data_dir;
+    pkg_str seinfo;
+    /** The raw gid list field: "none", a single gid or a comma separated list */
+    pkg_str gids;
+};
+
+/**
+ * Maps the packages list at path into memory and indexes it by package name
+ * and uid. No strings are copied, every pkg_str of the returned entries points
+ * straight into the mapping. Malformed lines are logged and left out of the
+ * list, see packagelist_malformed().
+ * @param path
+ *  The packages list to map, normally PACKAGES_LIST_FILE.
+ * @return
+ *  The mapped list, or NULL with errno set on failure.
+ */
+extern packagelist *packagelist_map(const char *path);
+
+/**
+ * Same as packagelist_map() but for an already opened file, for callers that
+ * need to validate the file before trusting it. The fd is not closed.
+ */
+extern packagelist *packagelist_map_fd(int fd);
+
+/**
+ * Unmaps a list returned by packagelist_map(), invalidating all of its entries.
+ * errno is preserved.
+ */
+extern void packagelist_unmap(packagelist *list);
+
+/**
+ * @return
+ *  The number of entries in the list.
+ */
+extern size_t packagelist_size(const packagelist *list);
+
+/**
+ * @return
+ *  The number of malformed lines that were left out of the list.
+ */
+extern size_t packagelist_malformed(const packagelist *list);
+
+/**
+ * @return
+ *  The i'th entry of the list, in file order.
+ */
+extern const pkg_entry *packagelist_entry(const packagelist *list, size_t i);
+
+/**
+ * Looks up a package by name in O(log n).
+ * @return
+ *  The entry, or NULL if the package is unknown.
+ */
+extern const pkg_entry *packagelist_find_name(const packagelist *list, const char *name);
+
+/**
+ * Looks up the packages running as uid in O(log n). Several packages can
+ * share a uid, so all of them are returned.
+ * @param entries
+ *  Set to the first of the matching entries, ordered by name.
+ * @return
+ *  The number of matching entries, 0 if none.
+ */
+extern size_t packagelist_find_uid(const packagelist *list, uid_t uid,
+        const pkg_entry * const **entries);
+
 __END_DECLS
 
 #endif /* PACKAGELISTPARSER_H_ */
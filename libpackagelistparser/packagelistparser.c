@@ -19,12 +19,16 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <sys/limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define LOG_TAG "packagelistparser"
 #include <utils/Log.h>
@@ -264,3 +268,328 @@ void packagelist_free(pkg_info *info)
         free(info);
     }
 }
+
+struct packagelist {
+    void *map;
+    size_t map_len;
+    size_t cnt;
+    size_t malformed;
+    pkg_entry *entries;
+    /* entries sorted by name, and by uid then name */
+    const pkg_entry **by_name;
+    const pkg_entry **by_uid;
+};
+
+static bool is_field_sep(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Returns the next field of the line [*p, end) and advances *p past it */
+static bool next_field(const char **p, const char *end, pkg_str *field)
+{
+    const char *s = *p;
+
+    while (s < end && is_field_sep(*s)) {
+        s++;
+    }
+
+    const char *e = s;
+    while (e < end && !is_field_sep(*e)) {
+        e++;
+    }
+
+    field->data = s;
+    field->len = e - s;
+    *p = e;
+    return e != s;
+}
+
+static bool parse_ulong(const pkg_str *field, unsigned long max, unsigned long *value)
+{
+    unsigned long v = 0;
+    size_t i;
+
+    if (field->len == 0) {
+        return false;
+    }
+
+    for (i = 0; i < field->len; i++) {
+        unsigned d = (unsigned) (field->data[i] - '0');
+        if (d > 9 || d > max || v > (max - d) / 10) {
+            return false;
+        }
+        v = v * 10 + d;
+    }
+
+    *value = v;
+    return true;
+}
+
+static bool parse_entry(const char *line, const char *end, pkg_entry *entry,
+        const char **errmsg)
+{
+    unsigned long tmp;
+    pkg_str field;
+
+    if (!next_field(&line, end, &entry->name)) {
+        *errmsg = "Could not get next token for \"package name\"";
+        return false;
+    }
+
+    if (!next_field(&line, end, &field) || !parse_ulong(&field, UID_MAX, &tmp)) {
+        *errmsg = "Could not convert field \"uid\" to integer value";
+        return false;
+    }
+    entry->uid = (uid_t) tmp;
+
+    if (!next_field(&line, end, &field) || !parse_ulong(&field, 1, &tmp)) {
+        *errmsg = "Field \"debuggable\" is not 0 or 1 boolean value";
+        return false;
+    }
+    entry->debuggable = (bool) tmp;
+
+    if (!next_field(&line, end, &entry->data_dir)) {
+        *errmsg = "Could not get next token for field \"data dir\"";
+        return false;
+    }
+
+    if (!next_field(&line, end, &entry->seinfo)) {
+        *errmsg = "Could not get next token for field \"seinfo\"";
+        return false;
+    }
+
+    /* Older files have no gid list, and anything after it is ignored */
+    next_field(&line, end, &entry->gids);
+    return true;
+}
+
+static int pkg_str_cmp(const pkg_str *a, const pkg_str *b)
+{
+    size_t len = a->len < b->len ? a->len : b->len;
+    int rc = memcmp(a->data, b->data, len);
+    if (rc) {
+        return rc;
+    }
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+static int cmp_by_name(const void *a, const void *b)
+{
+    const pkg_entry *ea = *(const pkg_entry * const *) a;
+    const pkg_entry *eb = *(const pkg_entry * const *) b;
+    return pkg_str_cmp(&ea->name, &eb->name);
+}
+
+static int cmp_by_uid(const void *a, const void *b)
+{
+    const pkg_entry *ea = *(const pkg_entry * const *) a;
+    const pkg_entry *eb = *(const pkg_entry * const *) b;
+    if (ea->uid != eb->uid) {
+        return ea->uid < eb->uid ? -1 : 1;
+    }
+    return pkg_str_cmp(&ea->name, &eb->name);
+}
+
+static bool index_list(packagelist *list)
+{
+    const char *p = list->map;
+    const char *end = p + list->map_len;
+    unsigned long lineno = 1;
+    size_t lines = 1;
+    size_t i;
+
+    for (i = 0; i < list->map_len; i++) {
+        if (p[i] == '\n') {
+            lines++;
+        }
+    }
+
+    list->entries = calloc(lines, sizeof(*list->entries));
+    list->by_name = calloc(lines, sizeof(*list->by_name));
+    list->by_uid = calloc(lines, sizeof(*list->by_uid));
+    if (!list->entries || !list->by_name || !list->by_uid) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (; p < end; lineno++) {
+        const char *eol = memchr(p, '\n', end - p);
+        const char *next = eol ? eol + 1 : end;
+        const char *errmsg = NULL;
+
+        if (!eol) {
+            eol = end;
+        }
+
+        /* Skip blank lines, such as the one after a trailing newline */
+        const char *s = p;
+        while (s < eol && is_field_sep(*s)) {
+            s++;
+        }
+        if (s == eol) {
+            p = next;
+            continue;
+        }
+
+        /* A malformed line costs only its own package, not the whole list */
+        pkg_entry *entry = &list->entries[list->cnt];
+        if (!parse_entry(p, eol, entry, &errmsg)) {
+            CLOGE("Error Parsing packages list on line: %lu for reason: %s",
+                    lineno, errmsg);
+            memset(entry, 0, sizeof(*entry));
+            list->malformed++;
+            p = next;
+            continue;
+        }
+
+        list->by_name[list->cnt] = entry;
+        list->by_uid[list->cnt] = entry;
+        list->cnt++;
+        p = next;
+    }
+
+    qsort(list->by_name, list->cnt, sizeof(*list->by_name), cmp_by_name);
+    qsort(list->by_uid, list->cnt, sizeof(*list->by_uid), cmp_by_uid);
+    return true;
+}
+
+packagelist *packagelist_map_fd(int fd)
+{
+    struct stat st;
+    packagelist *list;
+
+    if (TEMP_FAILURE_RETRY(fstat(fd, &st)) < 0) {
+        return NULL;
+    }
+
+    list = calloc(1, sizeof(*list));
+    if (!list) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    list->map_len = (size_t) st.st_size;
+    if ((off_t) list->map_len != st.st_size) {
+        free(list);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* An empty mapping is invalid, but so is an empty list */
+    if (list->map_len > 0) {
+        list->map = mmap(NULL, list->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (list->map == MAP_FAILED) {
+            list->map = NULL;
+            packagelist_unmap(list);
+            return NULL;
+        }
+    }
+
+    if (!index_list(list)) {
+        packagelist_unmap(list);
+        return NULL;
+    }
+
+    return list;
+}
+
+packagelist *packagelist_map(const char *path)
+{
+    packagelist *list;
+    int old_errno;
+    int fd;
+
+    fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        CLOGE("Could not open: \"%s\", error: \"%s\"\n", path, strerror(errno));
+        return NULL;
+    }
+
+    list = packagelist_map_fd(fd);
+
+    old_errno = errno;
+    close(fd);
+    errno = old_errno;
+    return list;
+}
+
+void packagelist_unmap(packagelist *list)
+{
+    int old_errno = errno;
+
+    if (list) {
+        if (list->map) {
+            munmap(list->map, list->map_len);
+        }
+        free(list->entries);
+        free(list->by_name);
+        free(list->by_uid);
+        free(list);
+    }
+
+    errno = old_errno;
+}
+
+size_t packagelist_size(const packagelist *list)
+{
+    return list->cnt;
+}
+
+size_t packagelist_malformed(const packagelist *list)
+{
+    return list->malformed;
+}
+
+const pkg_entry *packagelist_entry(const packagelist *list, size_t i)
+{
+    return i < list->cnt ? &list->entries[i] : NULL;
+}
+
+const pkg_entry *packagelist_find_name(const packagelist *list, const char *name)
+{
+    pkg_str key = { name, strlen(name) };
+    size_t lo = 0;
+    size_t hi = list->cnt;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int rc = pkg_str_cmp(&list->by_name[mid]->name, &key);
+        if (rc == 0) {
+            return list->by_name[mid];
+        }
+        if (rc < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+size_t packagelist_find_uid(const packagelist *list, uid_t uid,
+        const pkg_entry * const **entries)
+{
+    size_t lo = 0;
+    size_t hi = list->cnt;
+    size_t first;
+
+    /* lower bound of uid */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (list->by_uid[mid]->uid < uid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    first = lo;
+    while (lo < list->cnt && list->by_uid[lo]->uid == uid) {
+        lo++;
+    }
+
+    *entries = list->by_uid + first;
+    return lo - first;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include <packagelistparser/packagelistparser.h>
+
+static std::string str(const pkg_str& s) {
+    return std::string(s.data, s.len);
+}
+
+static packagelist* map_contents(TemporaryFile* tf, const std::string& contents) {
+    EXPECT_TRUE(android::base::WriteStringToFile(contents, tf->path));
+    return packagelist_map(tf->path);
+}
+
+TEST(packagelistparser, map_and_find) {
+    TemporaryFile tf;
+    packagelist* list = map_contents(&tf,
+            "com.example.b 10002 0 /data/data/com.example.b default 3003,1028\n"
+            "com.example.a 10001 1 /data/data/com.example.a platform none\n"
+            "com.example.shared 10002 0 /data/data/com.example.shared default 3003\n");
+    ASSERT_TRUE(list != nullptr);
+    ASSERT_EQ(3U, packagelist_size(list));
+
+    // Entries stay in file order.
+    EXPECT_EQ("com.example.b", str(packagelist_entry(list, 0)->name));
+    EXPECT_EQ("com.example.shared", str(packagelist_entry(list, 2)->name));
+    EXPECT_EQ(nullptr, packagelist_entry(list, 3));
+
+    const pkg_entry* a = packagelist_find_name(list, "com.example.a");
+    ASSERT_TRUE(a != nullptr);
+    EXPECT_EQ(10001U, a->uid);
+    EXPECT_TRUE(a->debuggable);
+    EXPECT_EQ("/data/data/com.example.a", str(a->data_dir));
+    EXPECT_EQ("platform", str(a->seinfo));
+    EXPECT_EQ("none", str(a->gids));
+
+    EXPECT_EQ("3003,1028", str(packagelist_find_name(list, "com.example.b")->gids));
+    EXPECT_EQ(nullptr, packagelist_find_name(list, "com.example"));
+    EXPECT_EQ(nullptr, packagelist_find_name(list, "com.example.bb"));
+
+    const pkg_entry* const* entries;
+    ASSERT_EQ(2U, packagelist_find_uid(list, 10002, &entries));
+    EXPECT_EQ("com.example.b", str(entries[0]->name));
+    EXPECT_EQ("com.example.shared", str(entries[1]->name));
+    EXPECT_EQ(0U, packagelist_find_uid(list, 10003, &entries));
+
+    packagelist_unmap(list);
+}
+
+TEST(packagelistparser, empty_and_old_format) {
+    TemporaryFile tf;
+    packagelist* list = map_contents(&tf, "");
+    ASSERT_TRUE(list != nullptr);
+    EXPECT_EQ(0U, packagelist_size(list));
+    EXPECT_EQ(nullptr, packagelist_find_name(list, "com.example.a"));
+    packagelist_unmap(list);
+
+    // No gid list and no trailing newline.
+    list = map_contents(&tf, "com.example.a 10001 0 /data/data/com.example.a default");
+    ASSERT_TRUE(list != nullptr);
+    ASSERT_EQ(1U, packagelist_size(list));
+    EXPECT_EQ(0U, packagelist_entry(list, 0)->gids.len);
+    packagelist_unmap(list);
+}
+
+TEST(packagelistparser, malformed) {
+    TemporaryFile tf;
+    const char* bad[] = {
+        "com.example.a 10001\n",
+        "com.example.a 1000x 0 /data/data/com.example.a default none\n",
+        "com.example.a 99999999999 0 /data/data/com.example.a default none\n",
+        "com.example.a 10001 2 /data/data/com.example.a default none\n",
+        "com.example.a 10001 0 /data/data/com.example.a\n",
+    };
+    for (const char* contents : bad) {
+        packagelist* list = map_contents(&tf, contents);
+        ASSERT_TRUE(list != nullptr) << contents;
+        EXPECT_EQ(0U, packagelist_size(list)) << contents;
+        EXPECT_EQ(1U, packagelist_malformed(list)) << contents;
+        packagelist_unmap(list);
+    }
+
+    // The packages around a malformed line are still found.
+    packagelist* list = map_contents(&tf,
+            "com.example.a 10001 0 /data/data/com.example.a default none\n"
+            "com.example.b 1000x 0 /data/data/com.example.b default none\n"
+            "com.example.c 10003 0 /data/data/com.example.c default none\n");
+    ASSERT_TRUE(list != nullptr);
+    EXPECT_EQ(2U, packagelist_size(list));
+    EXPECT_EQ(1U, packagelist_malformed(list));
+    EXPECT_TRUE(packagelist_find_name(list, "com.example.a") != nullptr);
+    EXPECT_EQ(nullptr, packagelist_find_name(list, "com.example.b"));
+    ASSERT_TRUE(packagelist_find_name(list, "com.example.c") != nullptr);
+    EXPECT_EQ(10003U, packagelist_find_name(list, "com.example.c")->uid);
+    packagelist_unmap(list);
+}
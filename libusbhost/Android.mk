@@ -56,3 +56,5 @@ LOCAL_SRC_FILES := usbhost.c
 LOCAL_CFLAGS := -Werror
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
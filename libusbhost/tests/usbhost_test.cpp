@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <linux/usbdevice_fs.h>
+
+#include <algorithm>
+#include <deque>
+
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "usbhost/usbhost.h"
+#include "../usbhost_private.h"
+
+// A stand-in for usbdevfs: submitted urbs sit in |submitted| until the test
+// completes them, after which they can be reaped in completion order.
+struct MockUsbdevfs {
+    std::deque<usbdevfs_urb*> submitted;
+    std::deque<usbdevfs_urb*> completed;
+
+    void complete(usbdevfs_urb* urb, int status, int actual) {
+        auto it = std::find(submitted.begin(), submitted.end(), urb);
+        ASSERT_NE(submitted.end(), it);
+        submitted.erase(it);
+        urb->status = status;
+        urb->actual_length = actual;
+        completed.push_back(urb);
+    }
+};
+
+static MockUsbdevfs* mock;
+
+static int mock_ioctl(int, unsigned long request, void* arg) {
+    switch (request) {
+    case USBDEVFS_SUBMITURB:
+        mock->submitted.push_back(static_cast<usbdevfs_urb*>(arg));
+        return 0;
+    case USBDEVFS_REAPURB:
+    case USBDEVFS_REAPURBNDELAY:
+        if (mock->completed.empty()) {
+            errno = EAGAIN;
+            return -1;
+        }
+        *static_cast<usbdevfs_urb**>(arg) = mock->completed.front();
+        mock->completed.pop_front();
+        return 0;
+    case USBDEVFS_DISCARDURB:
+        mock->complete(static_cast<usbdevfs_urb*>(arg), -ENOENT, 0);
+        return 0;
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+class UsbHostTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+        mock = &mock_;
+        usb_host_set_ioctl_hook(mock_ioctl);
+
+        // usb_device_new() only needs something readable that holds the
+        // descriptors, so a device descriptor in a temp file will do.
+        TemporaryFile tf;
+        ASSERT_NE(-1, tf.fd);
+        struct usb_device_descriptor desc;
+        memset(&desc, 0, sizeof(desc));
+        desc.bLength = USB_DT_DEVICE_SIZE;
+        desc.bDescriptorType = USB_DT_DEVICE;
+        desc.idVendor = 0x18d1;
+        desc.idProduct = 0x4ee1;
+        ASSERT_EQ(USB_DT_DEVICE_SIZE, write(tf.fd, &desc, USB_DT_DEVICE_SIZE));
+        // The device owns and closes the fd it is given.
+        device_ = usb_device_new("/dev/bus/usb/001/002", dup(tf.fd));
+        ASSERT_TRUE(device_ != NULL);
+    }
+
+    virtual void TearDown() {
+        if (device_) usb_device_close(device_);
+        usb_host_set_ioctl_hook(NULL);
+        mock = NULL;
+    }
+
+    struct usb_request* NewRequest(int address, void* buffer, int length) {
+        struct usb_endpoint_descriptor ep;
+        memset(&ep, 0, sizeof(ep));
+        ep.bLength = USB_DT_ENDPOINT_SIZE;
+        ep.bDescriptorType = USB_DT_ENDPOINT;
+        ep.bEndpointAddress = address;
+        ep.bmAttributes = USB_ENDPOINT_XFER_BULK;
+        ep.wMaxPacketSize = 512;
+        struct usb_request* req = usb_request_new(device_, &ep);
+        if (req) {
+            req->buffer = buffer;
+            req->buffer_length = length;
+        }
+        return req;
+    }
+
+    static usbdevfs_urb* Urb(struct usb_request* req) {
+        return static_cast<usbdevfs_urb*>(req->private_data);
+    }
+
+    MockUsbdevfs mock_;
+    struct usb_device* device_;
+};
+
+TEST_F(UsbHostTest, reap_empty) {
+    struct usb_request* reqs[4];
+
+    errno = 0;
+    EXPECT_TRUE(usb_request_reap(device_) == NULL);
+    EXPECT_EQ(EAGAIN, errno);
+    EXPECT_EQ(0, usb_request_reap_all(device_, reqs, 4));
+    EXPECT_EQ(0, usb_device_get_pending_requests(device_));
+    EXPECT_EQ(usb_device_get_fd(device_), usb_device_get_completion_fd(device_));
+}
+
+TEST_F(UsbHostTest, many_in_flight_across_endpoints) {
+    static const int kRequests = 8;
+    char buffers[kRequests][64];
+    struct usb_request* reqs[kRequests];
+
+    for (int i = 0; i < kRequests; ++i) {
+        int address = (i & 1) ? (USB_DIR_IN | 1) : (USB_DIR_OUT | 2);
+        reqs[i] = NewRequest(address, buffers[i], sizeof(buffers[i]));
+        ASSERT_TRUE(reqs[i] != NULL);
+        reqs[i]->client_data = &buffers[i];
+        ASSERT_EQ(0, usb_request_queue(reqs[i]));
+    }
+    EXPECT_EQ(kRequests, usb_device_get_pending_requests(device_));
+    EXPECT_EQ(kRequests, (int)mock_.submitted.size());
+
+    // Nothing done yet: reaping must not block.
+    EXPECT_TRUE(usb_request_reap(device_) == NULL);
+
+    // Finish them back to front; they come back in completion order.
+    for (int i = kRequests - 1; i >= 0; --i) {
+        mock_.complete(Urb(reqs[i]), 0, i);
+    }
+
+    struct usb_request* reaped[kRequests];
+    ASSERT_EQ(3, usb_request_reap_all(device_, reaped, 3));
+    EXPECT_EQ(kRequests - 3, usb_device_get_pending_requests(device_));
+    ASSERT_EQ(kRequests - 3, usb_request_reap_all(device_, reaped + 3, kRequests));
+    EXPECT_EQ(0, usb_device_get_pending_requests(device_));
+
+    for (int i = 0; i < kRequests; ++i) {
+        struct usb_request* req = reaped[i];
+        EXPECT_EQ(reqs[kRequests - 1 - i], req);
+        EXPECT_EQ(kRequests - 1 - i, req->actual_length);
+        EXPECT_EQ(0, req->status);
+        EXPECT_EQ(&buffers[kRequests - 1 - i], req->client_data);
+    }
+
+    for (int i = 0; i < kRequests; ++i) {
+        usb_request_free(reqs[i]);
+    }
+}
+
+TEST_F(UsbHostTest, cancel_reports_status) {
+    char buffer[16];
+    struct usb_request* req = NewRequest(USB_DIR_IN | 1, buffer, sizeof(buffer));
+    ASSERT_TRUE(req != NULL);
+
+    ASSERT_EQ(0, usb_request_queue(req));
+    ASSERT_EQ(0, usb_request_cancel(req));
+    EXPECT_EQ(req, usb_request_wait(device_));
+    EXPECT_EQ(-ENOENT, req->status);
+    EXPECT_EQ(0, usb_device_get_pending_requests(device_));
+
+    usb_request_free(req);
+}
+
+TEST_F(UsbHostTest, queue_limits_buffer_length) {
+    static char buffer[64 * 1024];
+    struct usb_request* req = NewRequest(USB_DIR_OUT | 2, buffer, sizeof(buffer));
+    ASSERT_TRUE(req != NULL);
+
+    ASSERT_EQ(0, usb_request_queue(req));
+    EXPECT_EQ(16384, Urb(req)->buffer_length);
+    EXPECT_EQ(0, usb_request_cancel(req));
+    EXPECT_EQ(req, usb_request_reap(device_));
+
+    usb_request_free(req);
+}
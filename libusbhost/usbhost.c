@@ -44,11 +44,13 @@
 #include <errno.h>
 #include <ctype.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include <linux/usbdevice_fs.h>
 #include <asm/byteorder.h>
 
 #include "usbhost/usbhost.h"
+#include "usbhost_private.h"
 
 #define DEV_DIR             "/dev"
 #define DEV_BUS_DIR         DEV_DIR "/bus"
@@ -81,8 +83,25 @@ struct usb_device {
     int desc_length;
     int fd;
     int writeable;
+    atomic_int pending_requests;
 };
 
+static usbdevfs_ioctl_fn usbdevfs_ioctl_hook;
+
+/* All usbdevfs requests go through here so tests can stand in for the kernel. */
+static int usbdevfs_ioctl(int fd, unsigned long request, void *arg)
+{
+    usbdevfs_ioctl_fn hook = usbdevfs_ioctl_hook;
+    if (hook)
+        return hook(fd, request, arg);
+    return ioctl(fd, request, arg);
+}
+
+void usb_host_set_ioctl_hook(usbdevfs_ioctl_fn hook)
+{
+    usbdevfs_ioctl_hook = hook;
+}
+
 static inline int badname(const char *name)
 {
     while(*name) {
@@ -373,6 +392,7 @@ struct usb_device *usb_device_new(const char *dev_name, int fd)
     device->desc_length = length;
     // assume we are writeable, since usb_device_get_fd will only return writeable fds
     device->writeable = 1;
+    atomic_init(&device->pending_requests, 0);
     return device;
 
 failed:
@@ -537,12 +557,12 @@ struct usb_descriptor_header *usb_descriptor_iter_next(struct usb_descriptor_ite
 
 int usb_device_claim_interface(struct usb_device *device, unsigned int interface)
 {
-    return ioctl(device->fd, USBDEVFS_CLAIMINTERFACE, &interface);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_CLAIMINTERFACE, &interface);
 }
 
 int usb_device_release_interface(struct usb_device *device, unsigned int interface)
 {
-    return ioctl(device->fd, USBDEVFS_RELEASEINTERFACE, &interface);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_RELEASEINTERFACE, &interface);
 }
 
 int usb_device_connect_kernel_driver(struct usb_device *device,
@@ -553,12 +573,12 @@ int usb_device_connect_kernel_driver(struct usb_device *device,
     ctl.ifno = interface;
     ctl.ioctl_code = (connect ? USBDEVFS_CONNECT : USBDEVFS_DISCONNECT);
     ctl.data = NULL;
-    return ioctl(device->fd, USBDEVFS_IOCTL, &ctl);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_IOCTL, &ctl);
 }
 
 int usb_device_set_configuration(struct usb_device *device, int configuration)
 {
-    return ioctl(device->fd, USBDEVFS_SETCONFIGURATION, &configuration);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_SETCONFIGURATION, &configuration);
 }
 
 int usb_device_set_interface(struct usb_device *device, unsigned int interface,
@@ -568,7 +588,7 @@ int usb_device_set_interface(struct usb_device *device, unsigned int interface,
 
     ctl.interface = interface;
     ctl.altsetting = alt_setting;
-    return ioctl(device->fd, USBDEVFS_SETINTERFACE, &ctl);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_SETINTERFACE, &ctl);
 }
 
 int usb_device_control_transfer(struct usb_device *device,
@@ -594,7 +614,7 @@ int usb_device_control_transfer(struct usb_device *device,
     ctrl.wLength = length;
     ctrl.data = buffer;
     ctrl.timeout = timeout;
-    return ioctl(device->fd, USBDEVFS_CONTROL, &ctrl);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_CONTROL, &ctrl);
 }
 
 int usb_device_bulk_transfer(struct usb_device *device,
@@ -614,12 +634,12 @@ int usb_device_bulk_transfer(struct usb_device *device,
     ctrl.len = length;
     ctrl.data = buffer;
     ctrl.timeout = timeout;
-    return ioctl(device->fd, USBDEVFS_BULK, &ctrl);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_BULK, &ctrl);
 }
 
 int usb_device_reset(struct usb_device *device)
 {
-    return ioctl(device->fd, USBDEVFS_RESET);
+    return usbdevfs_ioctl(device->fd, USBDEVFS_RESET, NULL);
 }
 
 struct usb_request *usb_request_new(struct usb_device *dev,
@@ -675,19 +695,33 @@ int usb_request_queue(struct usb_request *req)
         urb->buffer_length = req->buffer_length;
 
     do {
-        res = ioctl(req->dev->fd, USBDEVFS_SUBMITURB, urb);
+        res = usbdevfs_ioctl(req->dev->fd, USBDEVFS_SUBMITURB, urb);
     } while((res < 0) && (errno == EINTR));
 
+    if (res == 0)
+        atomic_fetch_add_explicit(&req->dev->pending_requests, 1, memory_order_relaxed);
     return res;
 }
 
+static struct usb_request *usb_request_reaped(struct usb_device *dev,
+                                              struct usbdevfs_urb *urb)
+{
+    struct usb_request *req = (struct usb_request*)urb->usercontext;
+
+    D("[ urb @%p status = %d, actual = %d ]\n",
+        urb, urb->status, urb->actual_length);
+    req->actual_length = urb->actual_length;
+    req->status = urb->status;
+    atomic_fetch_sub_explicit(&dev->pending_requests, 1, memory_order_relaxed);
+    return req;
+}
+
 struct usb_request *usb_request_wait(struct usb_device *dev)
 {
     struct usbdevfs_urb *urb = NULL;
-    struct usb_request *req = NULL;
 
     while (1) {
-        int res = ioctl(dev->fd, USBDEVFS_REAPURB, &urb);
+        int res = usbdevfs_ioctl(dev->fd, USBDEVFS_REAPURB, &urb);
         D("USBDEVFS_REAPURB returned %d\n", res);
         if (res < 0) {
             if(errno == EINTR) {
@@ -695,20 +729,55 @@ struct usb_request *usb_request_wait(struct usb_device *dev)
             }
             D("[ reap urb - error ]\n");
             return NULL;
-        } else {
-            D("[ urb @%p status = %d, actual = %d ]\n",
-                urb, urb->status, urb->actual_length);
-            req = (struct usb_request*)urb->usercontext;
-            req->actual_length = urb->actual_length;
         }
-        break;
+        return usb_request_reaped(dev, urb);
     }
-    return req;
+}
+
+struct usb_request *usb_request_reap(struct usb_device *dev)
+{
+    struct usbdevfs_urb *urb = NULL;
+    int res;
+
+    do {
+        res = usbdevfs_ioctl(dev->fd, USBDEVFS_REAPURBNDELAY, &urb);
+    } while ((res < 0) && (errno == EINTR));
+
+    if (res < 0) {
+        D("USBDEVFS_REAPURBNDELAY returned %d errno %d\n", res, errno);
+        return NULL;
+    }
+    return usb_request_reaped(dev, urb);
+}
+
+int usb_request_reap_all(struct usb_device *dev, struct usb_request **reqs, int count)
+{
+    int reaped = 0;
+
+    while (reaped < count) {
+        struct usb_request *req = usb_request_reap(dev);
+        if (!req) {
+            if (reaped == 0 && errno != EAGAIN)
+                return -1;
+            break;
+        }
+        reqs[reaped++] = req;
+    }
+    return reaped;
+}
+
+int usb_device_get_completion_fd(struct usb_device *dev)
+{
+    return dev->fd;
+}
+
+int usb_device_get_pending_requests(struct usb_device *dev)
+{
+    return atomic_load_explicit(&dev->pending_requests, memory_order_relaxed);
 }
 
 int usb_request_cancel(struct usb_request *req)
 {
     struct usbdevfs_urb *urb = ((struct usbdevfs_urb*)req->private_data);
-    return ioctl(req->dev->fd, USBDEVFS_DISCARDURB, urb);
+    return usbdevfs_ioctl(req->dev->fd, USBDEVFS_DISCARDURB, urb);
 }
-
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __USB_HOST_PRIVATE_H
+#define __USB_HOST_PRIVATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int (* usbdevfs_ioctl_fn)(int fd, unsigned long request, void *arg);
+
+/* Routes every usbdevfs ioctl made by the library through hook instead of
+ * the kernel, so tests can run against a mock backend.  Pass NULL to go
+ * back to ioctl().  Not thread safe; set it before opening any devices.
+ * Hidden, so only tests linking the static library can reach it.
+ */
+__attribute__((visibility("hidden")))
+void usb_host_set_ioctl_hook(usbdevfs_ioctl_fn hook);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __USB_HOST_PRIVATE_H */
@@ -21,8 +21,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include <utils/BlobCache.h>
 #include <utils/Errors.h>
+#include <utils/JenkinsHash.h>
 #include <utils/Log.h>
 
 #include <cutils/properties.h>
@@ -42,20 +45,18 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
         mMaxTotalSize(maxTotalSize),
-        mTotalSize(0) {
-    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
+        mTotalSize(0),
+        mOldest(NULL),
+        mYoungest(NULL) {
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
         size_t valueSize) {
+    set(key, keySize, value, valueSize, true);
+}
+
+void BlobCache::set(const void* key, size_t keySize, const void* value,
+        size_t valueSize, bool copyData) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)",
                 keySize, mMaxKeySize);
@@ -80,15 +81,12 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    sp<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
+    KeyRef keyRef(key, keySize);
 
     while (true) {
-        ssize_t index = mCacheEntries.indexOf(dummyEntry);
-        if (index < 0) {
+        CacheEntryMap::iterator it = mCacheEntries.find(keyRef);
+        if (it == mCacheEntries.end()) {
             // Create a new cache entry.
-            sp<Blob> keyBlob(new Blob(key, keySize, true));
-            sp<Blob> valueBlob(new Blob(value, valueSize, true));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -103,15 +101,24 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.add(CacheEntry(keyBlob, valueBlob));
+            sp<Blob> keyBlob(new Blob(key, keySize, copyData));
+            sp<Blob> valueBlob(new Blob(value, valueSize, copyData));
+            CacheEntry* entry = new CacheEntry(keyBlob, valueBlob);
+            // Index the entry by its own copy of the key, not by the caller's.
+            keyRef.mData = keyBlob->getData();
+            mCacheEntries.emplace(keyRef, std::unique_ptr<CacheEntry>(entry));
+            attach(entry);
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
                     keySize, valueSize);
         } else {
-            // Update the existing cache entry.
-            sp<Blob> valueBlob(new Blob(value, valueSize, true));
-            sp<Blob> oldValueBlob(mCacheEntries[index].getValue());
-            size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
+            // Update the existing cache entry.  It is being used, so it is the
+            // last one to evict if the cache needs cleaning.
+            CacheEntry* entry = it->second.get();
+            detach(entry);
+            attach(entry);
+            size_t newTotalSize = mTotalSize + valueSize -
+                    entry->getValue()->getSize();
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
                     // Clean the cache and try again.
@@ -124,7 +131,7 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.editItemAt(index).setValue(valueBlob);
+            entry->setValue(new Blob(value, valueSize, copyData));
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
@@ -140,17 +147,19 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
                 keySize, mMaxKeySize);
         return 0;
     }
-    sp<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, NULL);
-    ssize_t index = mCacheEntries.indexOf(dummyEntry);
-    if (index < 0) {
+    CacheEntryMap::iterator it = mCacheEntries.find(KeyRef(key, keySize));
+    if (it == mCacheEntries.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
         return 0;
     }
 
-    // The key was found. Return the value if the caller's buffer is large
-    // enough.
-    sp<Blob> valueBlob(mCacheEntries[index].getValue());
+    // The key was found, which makes it the most recently used entry.
+    CacheEntry* entry = it->second.get();
+    detach(entry);
+    attach(entry);
+
+    // Return the value if the caller's buffer is large enough.
+    sp<Blob> valueBlob(entry->getValue());
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
@@ -168,10 +177,9 @@ static inline size_t align4(size_t size) {
 
 size_t BlobCache::getFlattenedSize() const {
     size_t size = align4(sizeof(Header) + PROPERTY_VALUE_MAX);
-    for (size_t i = 0; i < mCacheEntries.size(); i++) {
-        const CacheEntry& e(mCacheEntries[i]);
-        sp<Blob> keyBlob = e.getKey();
-        sp<Blob> valueBlob = e.getValue();
+    for (const CacheEntry* e = mOldest; e != NULL; e = e->mYounger) {
+        sp<Blob> keyBlob = e->getKey();
+        sp<Blob> valueBlob = e->getValue();
         size += align4(sizeof(EntryHeader) + keyBlob->getSize() +
                        valueBlob->getSize());
     }
@@ -193,13 +201,12 @@ status_t BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = property_get("ro.build.id", buildId, "");
     memcpy(header->mBuildId, buildId, header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries, the least recently used first
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (size_t i = 0; i < mCacheEntries.size(); i++) {
-        const CacheEntry& e(mCacheEntries[i]);
-        sp<Blob> keyBlob = e.getKey();
-        sp<Blob> valueBlob = e.getValue();
+    for (const CacheEntry* e = mOldest; e != NULL; e = e->mYounger) {
+        sp<Blob> keyBlob = e->getKey();
+        sp<Blob> valueBlob = e->getValue();
         size_t keySize = keyBlob->getSize();
         size_t valueSize = valueBlob->getSize();
 
@@ -231,8 +238,16 @@ status_t BlobCache::flatten(void* buffer, size_t size) const {
 }
 
 status_t BlobCache::unflatten(void const* buffer, size_t size) {
+    return unflatten(buffer, size, true);
+}
+
+status_t BlobCache::unflattenInPlace(void const* buffer, size_t size) {
+    return unflatten(buffer, size, false);
+}
+
+status_t BlobCache::unflatten(void const* buffer, size_t size, bool copyData) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -258,9 +273,12 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
     const uint8_t* byteBuffer = reinterpret_cast<const uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
     size_t numEntries = header->mNumEntries;
+    // numEntries is only a hint until the entries are read, don't trust it
+    // beyond what the buffer could hold.
+    mCacheEntries.reserve(std::min(numEntries, size / sizeof(EntryHeader)));
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return BAD_VALUE;
         }
@@ -273,13 +291,13 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return BAD_VALUE;
         }
 
         const uint8_t* data = eheader->mData;
-        set(data, keySize, data + keySize, valueSize);
+        set(data, keySize, data + keySize, valueSize, copyData);
 
         byteOffset += totalSize;
     }
@@ -287,22 +305,12 @@ status_t BlobCache::unflatten(void const* buffer, size_t size) {
     return OK;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
-}
-
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
     while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.removeAt(i);
+        sp<Blob> key(mOldest->getKey());
+        remove(mCacheEntries.find(KeyRef(key->getData(), key->getSize())));
     }
 }
 
@@ -310,6 +318,44 @@ bool BlobCache::isCleanable() const {
     return mTotalSize > mMaxTotalSize / 2;
 }
 
+void BlobCache::attach(CacheEntry* entry) {
+    entry->mOlder = mYoungest;
+    entry->mYounger = NULL;
+    if (mYoungest != NULL) {
+        mYoungest->mYounger = entry;
+    } else {
+        mOldest = entry;
+    }
+    mYoungest = entry;
+}
+
+void BlobCache::detach(CacheEntry* entry) {
+    if (entry->mOlder != NULL) {
+        entry->mOlder->mYounger = entry->mYounger;
+    } else {
+        mOldest = entry->mYounger;
+    }
+    if (entry->mYounger != NULL) {
+        entry->mYounger->mOlder = entry->mOlder;
+    } else {
+        mYoungest = entry->mOlder;
+    }
+}
+
+void BlobCache::remove(CacheEntryMap::iterator it) {
+    CacheEntry* entry = it->second.get();
+    mTotalSize -= entry->getKey()->getSize() + entry->getValue()->getSize();
+    detach(entry);
+    mCacheEntries.erase(it);
+}
+
+void BlobCache::clear() {
+    mCacheEntries.clear();
+    mOldest = NULL;
+    mYoungest = NULL;
+    mTotalSize = 0;
+}
+
 BlobCache::Blob::Blob(const void* data, size_t size, bool copyData):
         mData(copyData ? malloc(size) : data),
         mSize(size),
@@ -325,14 +371,6 @@ BlobCache::Blob::~Blob() {
     }
 }
 
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
-    }
-}
-
 const void* BlobCache::Blob::getData() const {
     return mData;
 }
@@ -341,29 +379,13 @@ size_t BlobCache::Blob::getSize() const {
     return mSize;
 }
 
-BlobCache::CacheEntry::CacheEntry() {
-}
-
 BlobCache::CacheEntry::CacheEntry(const sp<Blob>& key, const sp<Blob>& value):
+        mOlder(NULL),
+        mYounger(NULL),
         mKey(key),
         mValue(value) {
 }
 
-BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
-        mKey(ce.mKey),
-        mValue(ce.mValue) {
-}
-
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
-const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
-    mKey = rhs.mKey;
-    mValue = rhs.mValue;
-    return *this;
-}
-
 sp<BlobCache::Blob> BlobCache::CacheEntry::getKey() const {
     return mKey;
 }
@@ -376,4 +398,16 @@ void BlobCache::CacheEntry::setValue(const sp<Blob>& value) {
     mValue = value;
 }
 
+BlobCache::KeyRef::KeyRef(const void* data, size_t size):
+        mData(data),
+        mSize(size),
+        mHash(JenkinsHashWhiten(JenkinsHashMixBytes(0,
+                reinterpret_cast<const uint8_t*>(data), size))) {
+}
+
+bool BlobCache::KeyRef::operator==(const KeyRef& rhs) const {
+    return mHash == rhs.mHash && mSize == rhs.mSize &&
+            memcmp(mData, rhs.mData, mSize) == 0;
+}
+
 } // namespace android
@@ -38,10 +38,10 @@ CallStack::CallStack(const char* logtag, int32_t ignoreDepth) {
 CallStack::~CallStack() {
 }
 
-void CallStack::update(int32_t ignoreDepth, pid_t tid) {
+void CallStack::update(int32_t ignoreDepth, pid_t tid, BacktraceMap* map) {
     mFrameLines.clear();
 
-    std::unique_ptr<Backtrace> backtrace(Backtrace::Create(BACKTRACE_CURRENT_PROCESS, tid));
+    std::unique_ptr<Backtrace> backtrace(Backtrace::Create(BACKTRACE_CURRENT_PROCESS, tid, map));
     if (!backtrace->Unwind(ignoreDepth)) {
         ALOGW("%s: Failed to unwind callstack.", __FUNCTION__);
     }
@@ -22,6 +22,9 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <memory>
+
+#include <backtrace/BacktraceMap.h>
 #include <utils/Log.h>
 #include <utils/Errors.h>
 #include <utils/ProcessCallStack.h>
@@ -132,7 +135,6 @@ void ProcessCallStack::clear() {
 void ProcessCallStack::update() {
     DIR *dp;
     struct dirent *ep;
-    struct dirent entry;
 
     dp = opendir(PATH_SELF_TASK);
     if (dp == NULL) {
@@ -157,9 +159,16 @@ void ProcessCallStack::update() {
     /*
      * Each tid is a directory inside of /proc/self/task
      * - Read every file in directory => get every tid
+     * - Collect them all, with their names, before unwinding anything, so
+     *   the directory is read in one go instead of being held open across
+     *   every unwind
      */
-    int code;
-    while ((code = readdir_r(dp, &entry, &ep)) == 0 && ep != NULL) {
+    for (;;) {
+        errno = 0;
+        if ((ep = readdir(dp)) == NULL) {
+            break;
+        }
+
         pid_t tid = -1;
         sscanf(ep->d_name, "%d", &tid);
 
@@ -170,14 +179,37 @@ void ProcessCallStack::update() {
             continue;
         }
 
-        ssize_t idx = mThreadMap.add(tid, ThreadInfo());
+        ThreadInfo threadInfo;
+        // Read/save thread name
+        threadInfo.threadName = getThreadName(tid);
+
+        ssize_t idx = mThreadMap.add(tid, threadInfo);
         if (idx < 0) { // returns negative error value on error
             ALOGE("%s: Failed to add new ThreadInfo: %s",
                   __FUNCTION__, strerror(-idx));
-            continue;
         }
+    }
+    if (errno != 0) {
+        ALOGE("%s: Failed to readdir from %s: %s",
+              __FUNCTION__, PATH_SELF_TASK, strerror(errno));
+    }
 
-        ThreadInfo& threadInfo = mThreadMap.editValueAt(static_cast<size_t>(idx));
+    closedir(dp);
+
+    /*
+     * Unwind every thread against one snapshot of the process's maps, with
+     * the function names cached across threads, rather than having each
+     * CallStack parse /proc/self/maps and symbolize the same frames again.
+     * If the map can't be built, every CallStack builds its own.
+     */
+    std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(selfPid));
+    if (map != NULL) {
+        map->EnableFunctionNameCache();
+    }
+
+    for (size_t i = 0; i < mThreadMap.size(); ++i) {
+        pid_t tid = mThreadMap.keyAt(i);
+        ThreadInfo& threadInfo = mThreadMap.editValueAt(i);
 
         /*
          * Ignore CallStack::update and ProcessCallStack::update for current thread
@@ -186,20 +218,11 @@ void ProcessCallStack::update() {
         int ignoreDepth = (selfPid == tid) ? IGNORE_DEPTH_CURRENT_THREAD : 0;
 
         // Update thread's call stacks
-        threadInfo.callStack.update(ignoreDepth, tid);
-
-        // Read/save thread name
-        threadInfo.threadName = getThreadName(tid);
+        threadInfo.callStack.update(ignoreDepth, tid, map.get());
 
         ALOGV("%s: Got call stack for tid %d (size %zu)",
               __FUNCTION__, tid, threadInfo.callStack.size());
     }
-    if (code != 0) { // returns positive error value on error
-        ALOGE("%s: Failed to readdir from %s: %s",
-              __FUNCTION__, PATH_SELF_TASK, strerror(code));
-    }
-
-    closedir(dp);
 }
 
 void ProcessCallStack::log(const char* logtag, android_LogPriority priority,
@@ -77,7 +77,7 @@ namespace android {
 // references, and is thus >= mStrong.
 //
 // A weakref_impl is allocated as the value of mRefs in a RefBase object on
-// construction.
+// construction, or on first use for REFS_LAZY objects, see below.
 // In the OBJECT_LIFETIME_STRONG case, it is deallocated in the RefBase
 // destructor iff the strong reference count was never incremented. The
 // destructor can be invoked either from decStrong, or from decWeak if there
@@ -116,10 +116,54 @@ namespace android {
 // count decrement, and all reference count decrements happen before the final
 // one, we are guaranteed that all other object accesses happen before the
 // object is destroyed.
+//
+// REFS_LAZY objects:
+// mRefs is a tagged word. weakref_impl objects are at least 4 byte aligned,
+// which leaves the two low bits of a pointer free. Normally mRefs holds the
+// weakref_impl allocated by the constructor, untagged, and never changes.
+// For REFS_LAZY objects it starts out holding the strong count, shifted left
+// and tagged with LAZY_STRONG. Strong references are counted there with
+// compare-and-swap, and without touching any weak count, since nothing can
+// observe it. The first createWeak(), getWeakRefs() or
+// extendObjectLifetime() allocates a weakref_impl, copies the strong count
+// (which also stands for that many weak references) into it, and installs
+// it tagged with LAZY_REFS using a single release compare-and-swap. From then
+// on the object behaves exactly as if mRefs had been set by the constructor.
+// The strong count and the pointer share a word so that no thread can
+// update the count after it was copied. Threads that find a LAZY_REFS
+// pointer issue an acquire fence before using it, which synchronizes with
+// its installation; untagged pointers were published with the object itself
+// and need none.
 
 
 #define INITIAL_STRONG_VALUE (1<<28)
 
+#define LAZY_STRONG 1
+#define LAZY_REFS 2
+
+static inline bool isLazyStrong(intptr_t v) {
+    return (v & LAZY_STRONG) != 0;
+}
+
+// Returns the weakref_impl held in v, which must not be a lazy strong count.
+template <typename T>
+static inline T* refsFromWord(intptr_t v) {
+    if (v & LAZY_REFS) {
+        // Pairs with the installation in getRefs().
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return reinterpret_cast<T*>(v & ~static_cast<intptr_t>(LAZY_REFS));
+    }
+    return reinterpret_cast<T*>(v);
+}
+
+static inline int32_t lazyStrongCount(intptr_t v) {
+    return static_cast<int32_t>(v >> 1);
+}
+
+static inline intptr_t toLazyStrong(int32_t c) {
+    return (static_cast<intptr_t>(c) << 1) | LAZY_STRONG;
+}
+
 // ---------------------------------------------------------------------------
 
 class RefBase::weakref_impl : public RefBase::weakref_type
@@ -385,9 +429,30 @@ private:
 
 // ---------------------------------------------------------------------------
 
+// mRefs replaced a plain weakref_impl pointer without changing the layout.
+static_assert(sizeof(std::atomic<intptr_t>) == sizeof(void*),
+        "RefBase::mRefs must stay one pointer in size");
+
 void RefBase::incStrong(const void* id) const
 {
-    weakref_impl* const refs = mRefs;
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (isLazyStrong(v)) {
+        do {
+            const int32_t c = lazyStrongCount(v);
+            ALOG_ASSERT(c > 0, "incStrong() called on %p after last strong ref", this);
+            // Nobody else can see the count yet, so the first reference
+            // can replace INITIAL_STRONG_VALUE directly.
+            const int32_t n = (c == INITIAL_STRONG_VALUE) ? 1 : c + 1;
+            if (mRefs.compare_exchange_weak(v, toLazyStrong(n),
+                    std::memory_order_relaxed, std::memory_order_relaxed)) {
+                if (c == INITIAL_STRONG_VALUE) {
+                    const_cast<RefBase*>(this)->onFirstRef();
+                }
+                return;
+            }
+        } while (isLazyStrong(v));
+    }
+    weakref_impl* const refs = refsFromWord<weakref_impl>(v);
     refs->incWeak(id);
     
     refs->addStrongRef(id);
@@ -409,7 +474,25 @@ void RefBase::incStrong(const void* id) const
 
 void RefBase::decStrong(const void* id) const
 {
-    weakref_impl* const refs = mRefs;
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (isLazyStrong(v)) {
+        do {
+            const int32_t c = lazyStrongCount(v);
+            ALOG_ASSERT(c >= 1, "decStrong() called on %p too many times", this);
+            if (mRefs.compare_exchange_weak(v, toLazyStrong(c - 1),
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                if (c == 1) {
+                    // Without a weakref_impl the lifetime can only be
+                    // OBJECT_LIFETIME_STRONG.
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    const_cast<RefBase*>(this)->onLastStrongRef(id);
+                    delete this;
+                }
+                return;
+            }
+        } while (isLazyStrong(v));
+    }
+    weakref_impl* const refs = refsFromWord<weakref_impl>(v);
     refs->removeStrongRef(id);
     const int32_t c = refs->mStrong.fetch_sub(1, std::memory_order_release);
 #if PRINT_REFS
@@ -439,7 +522,23 @@ void RefBase::forceIncStrong(const void* id) const
 {
     // Allows initial mStrong of 0 in addition to INITIAL_STRONG_VALUE.
     // TODO: Better document assumptions.
-    weakref_impl* const refs = mRefs;
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (isLazyStrong(v)) {
+        do {
+            const int32_t c = lazyStrongCount(v);
+            ALOG_ASSERT(c >= 0, "forceIncStrong called on %p after ref count underflow",
+                       this);
+            const int32_t n = (c == INITIAL_STRONG_VALUE) ? 1 : c + 1;
+            if (mRefs.compare_exchange_weak(v, toLazyStrong(n),
+                    std::memory_order_relaxed, std::memory_order_relaxed)) {
+                if (c == INITIAL_STRONG_VALUE || c == 0) {
+                    const_cast<RefBase*>(this)->onFirstRef();
+                }
+                return;
+            }
+        } while (isLazyStrong(v));
+    }
+    weakref_impl* const refs = refsFromWord<weakref_impl>(v);
     refs->incWeak(id);
     
     refs->addStrongRef(id);
@@ -463,7 +562,11 @@ void RefBase::forceIncStrong(const void* id) const
 int32_t RefBase::getStrongCount() const
 {
     // Debugging only; No memory ordering guarantees.
-    return mRefs->mStrong.load(std::memory_order_relaxed);
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (isLazyStrong(v)) {
+        return lazyStrongCount(v);
+    }
+    return refsFromWord<weakref_impl>(v)->mStrong.load(std::memory_order_relaxed);
 }
 
 RefBase* RefBase::weakref_type::refBase() const
@@ -653,48 +756,95 @@ void RefBase::weakref_type::trackMe(bool enable, bool retain)
 
 RefBase::weakref_type* RefBase::createWeak(const void* id) const
 {
-    mRefs->incWeak(id);
-    return mRefs;
+    weakref_impl* const refs = getRefs();
+    refs->incWeak(id);
+    return refs;
 }
 
 RefBase::weakref_type* RefBase::getWeakRefs() const
 {
-    return mRefs;
+    return getRefs();
+}
+
+RefBase::weakref_impl* RefBase::getRefs() const
+{
+    static_assert(alignof(weakref_impl) >= 4,
+            "the tags of mRefs need the two low bits of the pointer");
+
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (!isLazyStrong(v)) {
+        return refsFromWord<weakref_impl>(v);
+    }
+
+    // First weak reference of a REFS_LAZY object: move the strong count
+    // into a weakref_impl. It only becomes visible to other threads when
+    // it replaces the count, so it can be filled in without atomics.
+    weakref_impl* const refs = new weakref_impl(const_cast<RefBase*>(this));
+    do {
+        const int32_t c = lazyStrongCount(v);
+        refs->mStrong.store(c, std::memory_order_relaxed);
+        refs->mWeak.store(c == INITIAL_STRONG_VALUE ? 0 : c,
+                std::memory_order_relaxed);
+        if (mRefs.compare_exchange_weak(v,
+                reinterpret_cast<intptr_t>(refs) | LAZY_REFS,
+                std::memory_order_release, std::memory_order_relaxed)) {
+            return refs;
+        }
+    } while (isLazyStrong(v));
+
+    // Another thread installed one first.
+    delete refs;
+    return refsFromWord<weakref_impl>(v);
 }
 
 RefBase::RefBase()
-    : mRefs(new weakref_impl(this))
+    : mRefs(reinterpret_cast<intptr_t>(new weakref_impl(this)))
+{
+}
+
+RefBase::RefBase(uint32_t flags)
+    // Reference tracking needs the weakref_impl from the start.
+    : mRefs(((flags & REFS_LAZY) && !DEBUG_REFS)
+            ? toLazyStrong(INITIAL_STRONG_VALUE)
+            : reinterpret_cast<intptr_t>(new weakref_impl(this)))
 {
 }
 
 RefBase::~RefBase()
 {
-    if (mRefs->mStrong.load(std::memory_order_relaxed)
+    intptr_t v = mRefs.load(std::memory_order_relaxed);
+    if (isLazyStrong(v)) {
+        // REFS_LAZY and no weakref_impl was ever needed.
+        return;
+    }
+    weakref_impl* const refs = refsFromWord<weakref_impl>(v);
+
+    if (refs->mStrong.load(std::memory_order_relaxed)
             == INITIAL_STRONG_VALUE) {
         // we never acquired a strong (and/or weak) reference on this object.
-        delete mRefs;
+        delete refs;
     } else {
         // life-time of this object is extended to WEAK, in
         // which case weakref_impl doesn't out-live the object and we
         // can free it now.
-        int32_t flags = mRefs->mFlags.load(std::memory_order_relaxed);
+        int32_t flags = refs->mFlags.load(std::memory_order_relaxed);
         if ((flags & OBJECT_LIFETIME_MASK) != OBJECT_LIFETIME_STRONG) {
             // It's possible that the weak count is not 0 if the object
             // re-acquired a weak reference in its destructor
-            if (mRefs->mWeak.load(std::memory_order_relaxed) == 0) {
-                delete mRefs;
+            if (refs->mWeak.load(std::memory_order_relaxed) == 0) {
+                delete refs;
             }
         }
     }
     // for debugging purposes, clear this.
-    const_cast<weakref_impl*&>(mRefs) = NULL;
+    mRefs.store(0, std::memory_order_relaxed);
 }
 
 void RefBase::extendObjectLifetime(int32_t mode)
 {
     // Must be happens-before ordered with respect to construction or any
     // operation that could destroy the object.
-    mRefs->mFlags.fetch_or(mode, std::memory_order_relaxed);
+    getRefs()->mFlags.fetch_or(mode, std::memory_order_relaxed);
 }
 
 void RefBase::onFirstRef()
@@ -735,8 +885,14 @@ void RefBase::renameRefId(weakref_type* ref,
 
 void RefBase::renameRefId(RefBase* ref,
         const void* old_id, const void* new_id) {
-    ref->mRefs->renameStrongRefId(old_id, new_id);
-    ref->mRefs->renameWeakRefId(old_id, new_id);
+    // REFS_LAZY objects are never tracked, see RefBase(uint32_t).
+    intptr_t v = ref->mRefs.load(std::memory_order_relaxed);
+    if (v & (LAZY_STRONG | LAZY_REFS)) {
+        return;
+    }
+    weakref_impl* const refs = reinterpret_cast<weakref_impl*>(v);
+    refs->renameStrongRefId(old_id, new_id);
+    refs->renameWeakRefId(old_id, new_id);
 }
 
 }; // namespace android
@@ -41,6 +41,10 @@ static inline size_t max(size_t a, size_t b) {
     return a>b ? a : b;
 }
 
+static inline size_t min(size_t a, size_t b) {
+    return a<b ? a : b;
+}
+
 // ----------------------------------------------------------------------------
 
 VectorImpl::VectorImpl(size_t itemSize, uint32_t flags)
@@ -169,60 +173,86 @@ status_t VectorImpl::sort(VectorImpl::compar_t cmp)
     return sort(sortProxy, (void*)cmp);
 }
 
-status_t VectorImpl::sort(VectorImpl::compar_r_t cmp, void* state)
+// Stable merge sort of an array of item pointers, using scratch (which must
+// hold as many pointers) for the merges. Short runs are insertion sorted in
+// place first. Returns whichever of items or scratch holds the result.
+template <typename Compare>
+static const void** mergeSort(const void** items, const void** scratch,
+        size_t count, Compare cmp)
 {
-    // the sort must be stable. we're using insertion sort which
-    // is well suited for small and already sorted arrays
-    // for big arrays, it could be better to use mergesort
-    const ssize_t count = size();
-    if (count > 1) {
-        void* array = const_cast<void*>(arrayImpl());
-        void* temp = 0;
-        ssize_t i = 1;
-        while (i < count) {
-            void* item = reinterpret_cast<char*>(array) + mItemSize*(i);
-            void* curr = reinterpret_cast<char*>(array) + mItemSize*(i-1);
-            if (cmp(curr, item, state) > 0) {
-
-                if (!temp) {
-                    // we're going to have to modify the array...
-                    array = editArrayImpl();
-                    if (!array) return NO_MEMORY;
-                    temp = malloc(mItemSize);
-                    if (!temp) return NO_MEMORY;
-                    item = reinterpret_cast<char*>(array) + mItemSize*(i);
-                    curr = reinterpret_cast<char*>(array) + mItemSize*(i-1);
-                } else {
-                    _do_destroy(temp, 1);
-                }
+    const size_t kRunLength = 16;
 
-                _do_copy(temp, item, 1);
-
-                ssize_t j = i-1;
-                void* next = reinterpret_cast<char*>(array) + mItemSize*(i);                    
-                do {
-                    _do_destroy(next, 1);
-                    _do_copy(next, curr, 1);
-                    next = curr;
-                    --j;
-                    curr = NULL;
-                    if (j >= 0) {
-                        curr = reinterpret_cast<char*>(array) + mItemSize*(j);
-                    }
-                } while (j>=0 && (cmp(curr, temp, state) > 0));
-
-                _do_destroy(next, 1);
-                _do_copy(next, temp, 1);
+    for (size_t lo = 0; lo < count; lo += kRunLength) {
+        const size_t hi = min(lo + kRunLength, count);
+        for (size_t i = lo + 1; i < hi; i++) {
+            const void* item = items[i];
+            size_t j = i;
+            while (j > lo && cmp(items[j-1], item) > 0) {
+                items[j] = items[j-1];
+                j--;
             }
-            i++;
+            items[j] = item;
         }
-        
-        if (temp) {
-            _do_destroy(temp, 1);
-            free(temp);
+    }
+
+    const void** from = items;
+    const void** to = scratch;
+    for (size_t width = kRunLength; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2*width) {
+            const size_t mid = min(lo + width, count);
+            const size_t hi = min(lo + 2*width, count);
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                // only take from the right run when strictly smaller
+                to[k++] = (cmp(from[j], from[i]) < 0) ? from[j++] : from[i++];
+            }
+            while (i < mid) to[k++] = from[i++];
+            while (j < hi) to[k++] = from[j++];
         }
+        const void** tmp = from;
+        from = to;
+        to = tmp;
     }
-    return NO_ERROR;
+    return from;
+}
+
+status_t VectorImpl::sort(VectorImpl::compar_r_t cmp, void* state)
+{
+    // the sort must be stable. Already sorted arrays are detected in one
+    // pass and left alone, anything else is merge sorted through an array
+    // of pointers so that each item is copied exactly once, by rebuild().
+    const size_t count = size();
+    if (count < 2) {
+        return NO_ERROR;
+    }
+
+    const char* array = reinterpret_cast<const char*>(arrayImpl());
+    size_t i = 1;
+    while (i < count && cmp(array + mItemSize*(i-1), array + mItemSize*i, state) <= 0) {
+        i++;
+    }
+    if (i == count) {
+        return NO_ERROR;
+    }
+
+    size_t pointers_size;
+    LOG_ALWAYS_FATAL_IF(!safe_mul(&pointers_size, count, 2 * sizeof(void*)),
+                        "pointers_size overflow");
+    const void** items = static_cast<const void**>(malloc(pointers_size));
+    if (!items) {
+        return NO_MEMORY;
+    }
+    for (i = 0; i < count; i++) {
+        items[i] = array + mItemSize*i;
+    }
+
+    const void** sorted = mergeSort(items, items + count, count,
+            [cmp, state](const void* lhs, const void* rhs) {
+                return cmp(lhs, rhs, state);
+            });
+    status_t err = rebuild(sorted, count);
+    free(items);
+    return err;
 }
 
 void VectorImpl::pop()
@@ -376,6 +406,44 @@ void VectorImpl::release_storage()
     }
 }
 
+status_t VectorImpl::rebuild(const void* const* items, size_t count)
+{
+    if (count == 0) {
+        release_storage();
+        mStorage = 0;
+        mCount = 0;
+        return NO_ERROR;
+    }
+
+    size_t new_alloc_size;
+    LOG_ALWAYS_FATAL_IF(!safe_mul(&new_alloc_size, max(count, capacity()), mItemSize),
+                        "new_alloc_size overflow");
+    SharedBuffer* sb = SharedBuffer::alloc(new_alloc_size);
+    if (!sb) {
+        return NO_MEMORY;
+    }
+
+    // Copy runs of items that were adjacent in their source with a single
+    // _do_copy(), they are common when the input was nearly in order.
+    char* array = reinterpret_cast<char*>(sb->data());
+    size_t i = 0;
+    while (i < count) {
+        const char* first = reinterpret_cast<const char*>(items[i]);
+        size_t run = 1;
+        while (i + run < count && items[i + run] == first + mItemSize*run) {
+            run++;
+        }
+        _do_copy(array + mItemSize*i, first, run);
+        i += run;
+    }
+
+    // items may point into the old storage, so only release it now
+    release_storage();
+    mStorage = array;
+    mCount = count;
+    return NO_ERROR;
+}
+
 void* VectorImpl::_grow(size_t where, size_t amount)
 {
 //    ALOGV("_grow(this=%p, where=%d, amount=%d) count=%d, capacity=%d",
@@ -549,11 +617,19 @@ void VectorImpl::_do_splat(void* dest, const void* item, size_t num) const {
 }
 
 void VectorImpl::_do_move_forward(void* dest, const void* from, size_t num) const {
-    do_move_forward(dest, from, num);
+    if ((mFlags & HAS_TRIVIAL_COPY) && (mFlags & HAS_TRIVIAL_DTOR)) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_forward(dest, from, num);
+    }
 }
 
 void VectorImpl::_do_move_backward(void* dest, const void* from, size_t num) const {
-    do_move_backward(dest, from, num);
+    if ((mFlags & HAS_TRIVIAL_COPY) && (mFlags & HAS_TRIVIAL_DTOR)) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_backward(dest, from, num);
+    }
 }
 
 /*****************************************************************************/
@@ -633,19 +709,7 @@ ssize_t SortedVectorImpl::add(const void* item)
 
 ssize_t SortedVectorImpl::merge(const VectorImpl& vector)
 {
-    // naive merge...
-    if (!vector.isEmpty()) {
-        const void* buffer = vector.arrayImpl();
-        const size_t is = itemSize();
-        size_t s = vector.size();
-        for (size_t i=0 ; i<s ; i++) {
-            ssize_t err = add( reinterpret_cast<const char*>(buffer) + i*is );
-            if (err<0) {
-                return err;
-            }
-        }
-    }
-    return NO_ERROR;
+    return merge(vector.arrayImpl(), vector.size());
 }
 
 ssize_t SortedVectorImpl::merge(const SortedVectorImpl& vector)
@@ -654,18 +718,82 @@ ssize_t SortedVectorImpl::merge(const SortedVectorImpl& vector)
     ssize_t err = NO_ERROR;
     if (!vector.isEmpty()) {
         // first take care of the case where the vectors are sorted together
-        if (do_compare(vector.itemLocation(vector.size()-1), arrayImpl()) <= 0) {
+        if (isEmpty() ||
+                do_compare(vector.itemLocation(vector.size()-1), arrayImpl()) < 0) {
             err = VectorImpl::insertVectorAt(static_cast<const VectorImpl&>(vector), 0);
-        } else if (do_compare(vector.arrayImpl(), itemLocation(size()-1)) >= 0) {
+        } else if (do_compare(vector.arrayImpl(), itemLocation(size()-1)) > 0) {
             err = VectorImpl::appendVector(static_cast<const VectorImpl&>(vector));
         } else {
-            // this could be made a little better
-            err = merge(static_cast<const VectorImpl&>(vector));
+            err = merge(vector.arrayImpl(), vector.size());
         }
     }
     return err;
 }
 
+ssize_t SortedVectorImpl::merge(const void* array, size_t length)
+{
+    // Same result as add()ing each item in turn, but the new items are
+    // sorted once and merged with ours in a single pass instead of being
+    // inserted one by one, shifting the tail each time.
+    if (length == 0) {
+        return NO_ERROR;
+    }
+
+    const size_t count = size();
+    const size_t s = itemSize();
+    size_t pointers;
+    size_t pointers_size;
+    LOG_ALWAYS_FATAL_IF(!safe_mul(&pointers, length, static_cast<size_t>(3u)) ||
+                        !safe_add(&pointers, pointers, count) ||
+                        !safe_mul(&pointers_size, pointers, sizeof(void*)),
+                        "pointers_size overflow");
+    const void** items = static_cast<const void**>(malloc(pointers_size));
+    if (!items) {
+        return NO_MEMORY;
+    }
+    for (size_t i = 0; i < length; i++) {
+        items[i] = reinterpret_cast<const char*>(array) + i*s;
+    }
+
+    const void** sorted = mergeSort(items, items + length, length,
+            [this](const void* lhs, const void* rhs) {
+                return do_compare(lhs, rhs);
+            });
+
+    // Equal new items replace one another, so only the last of each counts
+    size_t unique = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (i + 1 < length && do_compare(sorted[i], sorted[i + 1]) == 0) {
+            continue;
+        }
+        sorted[unique++] = sorted[i];
+    }
+
+    const char* ours = reinterpret_cast<const char*>(arrayImpl());
+    const void** merged = items + 2*length;
+    size_t i = 0, j = 0, k = 0;
+    while (i < count && j < unique) {
+        const void* item = ours + i*s;
+        const int c = do_compare(item, sorted[j]);
+        if (c < 0) {
+            merged[k++] = item;
+            i++;
+        } else {
+            // a new item equal to one of ours replaces it, as in add()
+            merged[k++] = sorted[j++];
+            if (c == 0) {
+                i++;
+            }
+        }
+    }
+    while (i < count) merged[k++] = ours + s*i++;
+    while (j < unique) merged[k++] = sorted[j++];
+
+    status_t err = rebuild(merged, k);
+    free(items);
+    return err;
+}
+
 ssize_t SortedVectorImpl::remove(const void* item)
 {
     ssize_t i = indexOf(item);
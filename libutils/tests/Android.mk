@@ -26,6 +26,7 @@ LOCAL_SRC_FILES := \
     BitSet_test.cpp \
     Looper_test.cpp \
     LruCache_test.cpp \
+    RefBase_test.cpp \
     String8_test.cpp \
     StrongPointer_test.cpp \
     Unicode_test.cpp \
@@ -46,3 +47,11 @@ LOCAL_SRC_FILES := Vector_test.cpp
 LOCAL_STATIC_LIBRARIES := libutils liblog
 
 include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libutils_benchmark
+LOCAL_SRC_FILES := Vector_benchmark.cpp
+LOCAL_SHARED_LIBRARIES := liblog libutils
+
+include $(BUILD_NATIVE_BENCHMARK)
@@ -258,6 +258,32 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the two oldest entries, making them the most recent.
+    for (int i = 0; i < 2; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The entries used last survived, the others were evicted first.
+    for (int i = 0; i < maxEntries+1; i++) {
+        SCOPED_TRACE(i);
+        uint8_t k = i;
+        bool recent = i < 2 || i >= maxEntries - (maxEntries/2 - 2);
+        ASSERT_EQ(recent ? size_t(1) : size_t(0), mBC->get(&k, 1, NULL, 0));
+    }
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -333,6 +359,65 @@ TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenKeepsEvictionOrder) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Make the oldest entry the most recent.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, NULL, 0));
+    }
+
+    roundTrip();
+
+    // Overflowing the loaded cache evicts the same entries as the original.
+    uint8_t k = maxEntries;
+    mBC->set(&k, 1, "x", 1);
+    mBC2->set(&k, 1, "x", 1);
+    for (int i = 0; i < maxEntries+1; i++) {
+        SCOPED_TRACE(i);
+        k = i;
+        ASSERT_EQ(mBC->get(&k, 1, NULL, 0), mBC2->get(&k, 1, NULL, 0));
+    }
+    k = 0;
+    ASSERT_EQ(size_t(1), mBC2->get(&k, 1, NULL, 0));
+}
+
+TEST_F(BlobCacheFlattenTest, UnflattenInPlaceUsesBuffer) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+
+    size_t size = mBC->getFlattenedSize();
+    uint8_t* flat = new uint8_t[size];
+    ASSERT_EQ(OK, mBC->flatten(flat, size));
+    ASSERT_EQ(OK, mBC2->unflattenInPlace(flat, size));
+
+    ASSERT_EQ(size_t(4), mBC2->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+
+    // The value wasn't copied, it is read straight from the buffer.
+    uint8_t* value = static_cast<uint8_t*>(memmem(flat, size, "efgh", 4));
+    ASSERT_TRUE(value != NULL);
+    value[0] = 'E';
+    ASSERT_EQ(size_t(4), mBC2->get("abcd", 4, buf, 4));
+    ASSERT_EQ('E', buf[0]);
+
+    // Setting a value copies it, as usual.
+    mBC2->set("abcd", 4, "ijkl", 4);
+    value[0] = 'e';
+    ASSERT_EQ(size_t(4), mBC2->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "ijkl", 4));
+
+    // Unflattening again drops the references to the buffer.
+    ASSERT_EQ(BAD_VALUE, mBC2->unflattenInPlace(flat, 0));
+    delete[] flat;
+    ASSERT_EQ(size_t(0), mBC2->get("abcd", 4, buf, 4));
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenCatchesBufferTooSmall) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
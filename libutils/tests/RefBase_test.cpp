@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <utils/StrongPointer.h>
+#include <utils/RefBase.h>
+
+using namespace android;
+
+class Foo : public RefBase {
+public:
+    Foo(bool* deleted_check, bool lazy)
+        : RefBase(lazy ? REFS_LAZY : 0), mDeleted(deleted_check), mFirstRefs(0) {
+        *mDeleted = false;
+    }
+
+    ~Foo() {
+        *mDeleted = true;
+    }
+
+    int firstRefs() const { return mFirstRefs; }
+
+protected:
+    virtual void onFirstRef() {
+        mFirstRefs++;
+    }
+
+private:
+    bool* mDeleted;
+    int mFirstRefs;
+};
+
+class RefBaseTest : public testing::TestWithParam<bool> {
+};
+
+TEST_P(RefBaseTest, strongOnly) {
+    bool isDeleted;
+    Foo* foo = new Foo(&isDeleted, GetParam());
+    {
+        sp<Foo> sp1(foo);
+        EXPECT_EQ(1, foo->getStrongCount());
+        EXPECT_EQ(1, foo->firstRefs());
+        sp<Foo> sp2 = sp1;
+        EXPECT_EQ(2, foo->getStrongCount());
+        sp1.clear();
+        EXPECT_EQ(1, foo->getStrongCount());
+        ASSERT_FALSE(isDeleted) << "deleted too early! still has a reference!";
+    }
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+}
+
+TEST_P(RefBaseTest, weakAfterStrong) {
+    bool isDeleted;
+    sp<Foo> sp1 = new Foo(&isDeleted, GetParam());
+    sp<Foo> sp2 = sp1;
+    wp<Foo> wp1 = sp1;
+    EXPECT_EQ(2, sp1->getStrongCount());
+    // Two strong references, and the weak one
+    EXPECT_EQ(3, wp1.get_refs()->getWeakCount());
+
+    sp<Foo> promoted = wp1.promote();
+    EXPECT_EQ(sp1, promoted);
+    EXPECT_EQ(3, sp1->getStrongCount());
+
+    promoted.clear();
+    sp1.clear();
+    sp2.clear();
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+    EXPECT_EQ(NULL, wp1.promote().get());
+}
+
+TEST_P(RefBaseTest, weakBeforeStrong) {
+    bool isDeleted;
+    Foo* foo = new Foo(&isDeleted, GetParam());
+    wp<Foo> wp1 = foo;
+    {
+        sp<Foo> sp1 = wp1.promote();
+        ASSERT_EQ(foo, sp1.get());
+        EXPECT_EQ(1, foo->getStrongCount());
+    }
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+}
+
+TEST_P(RefBaseTest, weakOnly) {
+    bool isDeleted;
+    {
+        wp<Foo> wp1 = new Foo(&isDeleted, GetParam());
+        ASSERT_FALSE(isDeleted);
+    }
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+}
+
+// Weak references created while other threads copy sp<> around must not
+// lose or duplicate any of the strong counts.
+TEST_P(RefBaseTest, racingWeak) {
+    const int kThreads = 4;
+    const int kIterations = 100000;
+    for (int round = 0; round < 20; round++) {
+        bool isDeleted;
+        sp<Foo> sp1 = new Foo(&isDeleted, GetParam());
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.emplace_back([&sp1, &go, kIterations]() {
+                while (!go) {}
+                for (int j = 0; j < kIterations; j++) {
+                    sp<Foo> copy = sp1;
+                }
+            });
+        }
+        go = true;
+        wp<Foo> wp1 = sp1;
+        for (auto& t : threads) {
+            t.join();
+        }
+        EXPECT_EQ(1, sp1->getStrongCount());
+        EXPECT_EQ(2, wp1.get_refs()->getWeakCount());
+        sp1.clear();
+        ASSERT_TRUE(isDeleted) << "foo was leaked!";
+        EXPECT_EQ(NULL, wp1.promote().get());
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Lazy, RefBaseTest, testing::Values(false, true));
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <benchmark/benchmark.h>
+
+#include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Adding items one at a time is quadratic, keep it to sizes that finish
+static const int kMaxOneByOne = 1 << 16;
+
+static int compareInt(const int* lhs, const int* rhs) {
+    return (*lhs > *rhs) - (*lhs < *rhs);
+}
+
+static void fillRandom(Vector<int>& vector, size_t count) {
+    srand(42);
+    vector.clear();
+    vector.setCapacity(count);
+    for (size_t i = 0; i < count; i++) {
+        vector.add(rand());
+    }
+}
+
+static void BM_Vector_sort(benchmark::State& state) {
+    Vector<int> unsorted;
+    fillRandom(unsorted, state.range_x());
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        Vector<int> vector = unsorted;
+        vector.editArray();
+        state.ResumeTiming();
+        vector.sort(compareInt);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_Vector_sort)->Range(10, 1 << 20);
+
+static void BM_SortedVector_add(benchmark::State& state) {
+    Vector<int> items;
+    fillRandom(items, state.range_x());
+    while (state.KeepRunning()) {
+        SortedVector<int> vector;
+        for (size_t i = 0; i < items.size(); i++) {
+            vector.add(items[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_SortedVector_add)->Range(10, kMaxOneByOne);
+
+static void BM_SortedVector_merge(benchmark::State& state) {
+    Vector<int> items;
+    fillRandom(items, state.range_x());
+    while (state.KeepRunning()) {
+        SortedVector<int> vector;
+        vector.merge(items.array(), items.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_SortedVector_merge)->Range(10, 1 << 20);
+
+static void fillPairs(Vector< key_value_pair_t<int, int> >& pairs, size_t count) {
+    Vector<int> keys;
+    fillRandom(keys, count);
+    pairs.setCapacity(count);
+    for (size_t i = 0; i < count; i++) {
+        pairs.add(key_value_pair_t<int, int>(keys[i], i));
+    }
+}
+
+static void BM_KeyedVector_add(benchmark::State& state) {
+    Vector< key_value_pair_t<int, int> > pairs;
+    fillPairs(pairs, state.range_x());
+    while (state.KeepRunning()) {
+        KeyedVector<int, int> vector;
+        for (size_t i = 0; i < pairs.size(); i++) {
+            vector.add(pairs[i].key, pairs[i].value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_KeyedVector_add)->Range(10, kMaxOneByOne);
+
+static void BM_KeyedVector_addVector(benchmark::State& state) {
+    Vector< key_value_pair_t<int, int> > pairs;
+    fillPairs(pairs, state.range_x());
+    while (state.KeepRunning()) {
+        KeyedVector<int, int> vector;
+        vector.add(pairs);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range_x());
+}
+BENCHMARK(BM_KeyedVector_addVector)->Range(10, 1 << 20);
+
+}  // namespace android
+
+BENCHMARK_MAIN();
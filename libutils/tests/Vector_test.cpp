@@ -18,6 +18,8 @@
 
 #define __STDC_LIMIT_MACROS
 #include <stdint.h>
+#include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
 #include <utils/Vector.h>
 #include <cutils/log.h>
 #include <gtest/gtest.h>
@@ -149,4 +151,89 @@ TEST_F(VectorTest, editArray_Shared) {
   }
 }
 
+struct KeySeq {
+  int key;
+  int seq;
+};
+
+static int compareKey(const KeySeq* lhs, const KeySeq* rhs) {
+  return lhs->key - rhs->key;
+}
+
+TEST_F(VectorTest, sort_Stable) {
+  Vector<KeySeq> vector;
+  const int count = 10000;
+  for (int i = 0; i < count; i++) {
+    KeySeq item = { (i * 7919) % 97, i };
+    vector.add(item);
+  }
+  Vector<KeySeq> original = vector;
+
+  ASSERT_EQ(NO_ERROR, vector.sort(compareKey));
+  ASSERT_EQ(static_cast<size_t>(count), vector.size());
+  for (size_t i = 1; i < vector.size(); ++i) {
+    ASSERT_LE(vector[i-1].key, vector[i].key);
+    if (vector[i-1].key == vector[i].key) {
+      ASSERT_LT(vector[i-1].seq, vector[i].seq);
+    }
+  }
+
+  // The copy we shared the buffer with must not have been reordered.
+  for (size_t i = 0; i < original.size(); ++i) {
+    ASSERT_EQ(static_cast<int>(i), original[i].seq);
+  }
+}
+
+TEST_F(VectorTest, sort_AlreadySorted) {
+  Vector<KeySeq> vector;
+  for (int i = 0; i < 100; i++) {
+    KeySeq item = { i / 3, i };
+    vector.add(item);
+  }
+  Vector<KeySeq> copy = vector;
+
+  // Nothing to do, so the buffer stays shared.
+  ASSERT_EQ(NO_ERROR, vector.sort(compareKey));
+  EXPECT_EQ(copy.array(), vector.array());
+}
+
+TEST_F(VectorTest, SortedVector_mergeArray) {
+  SortedVector<int> vector;
+  vector.add(10);
+  vector.add(20);
+  vector.add(30);
+
+  const int items[] = { 25, 5, 20, 35, 5, 15 };
+  vector.merge(items, sizeof(items) / sizeof(items[0]));
+
+  const int expected[] = { 5, 10, 15, 20, 25, 30, 35 };
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), vector.size());
+  for (size_t i = 0; i < vector.size(); ++i) {
+    EXPECT_EQ(expected[i], vector[i]);
+  }
+}
+
+TEST_F(VectorTest, KeyedVector_addVector) {
+  // Must match adding the pairs one by one: the last value for a key wins.
+  Vector< key_value_pair_t<int, int> > items;
+  KeyedVector<int, int> expected;
+  for (int i = 0; i < 1000; i++) {
+    key_value_pair_t<int, int> item((i * 31) % 200, i);
+    items.add(item);
+    expected.add(item.key, item.value);
+  }
+
+  KeyedVector<int, int> vector;
+  vector.add(7, -1);
+  vector.add(1000, -1);
+  expected.add(1000, -1);
+  vector.add(items);
+
+  ASSERT_EQ(expected.size(), vector.size());
+  for (size_t i = 0; i < vector.size(); ++i) {
+    EXPECT_EQ(expected.keyAt(i), vector.keyAt(i));
+    EXPECT_EQ(expected.valueAt(i), vector.valueAt(i));
+  }
+}
+
 } // namespace android
@@ -104,3 +104,21 @@ LOCAL_STATIC_LIBRARIES := \
 
 LOCAL_MODULE_HOST_OS := darwin linux windows
 include $(BUILD_HOST_NATIVE_TEST)
+
+# Benchmarks.
+include $(CLEAR_VARS)
+LOCAL_MODULE := ziparchive-benchmarks
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS := $(libziparchive_common_c_flags)
+LOCAL_CPPFLAGS := $(libziparchive_common_cpp_flags)
+LOCAL_SRC_FILES := zip_writer_benchmark.cc
+LOCAL_SHARED_LIBRARIES := \
+    libbase \
+    liblog \
+
+LOCAL_STATIC_LIBRARIES := \
+    libziparchive \
+    libz \
+    libutils \
+
+include $(BUILD_NATIVE_BENCHMARK)
@@ -22,11 +22,17 @@
 
 #include <sys/param.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <deque>
 #include <memory>
 #include <vector>
 #include <zlib.h>
+
+#if !defined(_WIN32)
+#include <future>
+#endif
 #define DEF_MEM_LEVEL 8                // normally in zutil.h?
 
 #if !defined(powerof2)
@@ -42,6 +48,12 @@ enum {
 // Size of the output buffer used for compression.
 static const size_t kBufSize = 32768u;
 
+// Size of the chunks of an entry deflated concurrently when compressing on several threads.
+static const size_t kChunkSize = 128u * 1024u;
+
+// Deflate refers back at most this far, so this much of the previous chunk primes the next.
+static const size_t kDictionarySize = 32768u;
+
 // No error, operation completed successfully.
 static const int32_t kNoError = 0;
 
@@ -63,15 +75,23 @@ static const int32_t kInvalidAlign32Flag = -5;
 // The alignment parameter is not a power of 2.
 static const int32_t kInvalidAlignment = -6;
 
+// The compression level is not one zlib supports.
+static const int32_t kInvalidCompressionLevel = -7;
+
+// Indexed by the negated error code.
 static const char* sErrorCodes[] = {
+    "No error",
     "Invalid state",
     "IO error",
     "Invalid entry name",
     "Zlib error",
+    "Start aligned function cannot be called with the aligned flag",
+    "Alignment is not a power of 2",
+    "Invalid compression level",
 };
 
 const char* ZipWriter::ErrorCodeString(int32_t error_code) {
-  if (error_code < 0 && (-error_code) < static_cast<int32_t>(arraysize(sErrorCodes))) {
+  if (error_code <= 0 && (-error_code) < static_cast<int32_t>(arraysize(sErrorCodes))) {
     return sErrorCodes[-error_code];
   }
   return nullptr;
@@ -82,7 +102,35 @@ static void DeleteZStream(z_stream* stream) {
   delete stream;
 }
 
+// The deflated data of one chunk of an entry, along with the CRC of its input.
+struct ZipWriter::DeflatedChunk {
+  std::vector<uint8_t> data;
+  uint32_t crc32;
+  size_t uncompressed_size;
+  bool ok;
+};
+
+// The state of a compressed entry written on several threads.
+struct ZipWriter::ParallelDeflate {
+  ParallelDeflate(int level, size_t threads) : level(level), threads(threads) {
+    input.reserve(kChunkSize);
+  }
+
+  const int level;
+  const size_t threads;
+
+  // The input of the chunk being filled, and the end of the input of the chunk before it.
+  std::vector<uint8_t> input;
+  std::vector<uint8_t> dictionary;
+
+#if !defined(_WIN32)
+  // The chunks being deflated, in the order they are written.
+  std::deque<std::future<DeflatedChunk>> pending;
+#endif
+};
+
 ZipWriter::ZipWriter(FILE* f) : file_(f), current_offset_(0), state_(State::kWritingZip),
+                                compression_level_(Z_BEST_COMPRESSION), compression_threads_(1),
                                 z_stream_(nullptr, DeleteZStream), buffer_(kBufSize) {
 }
 
@@ -90,8 +138,11 @@ ZipWriter::ZipWriter(ZipWriter&& writer) : file_(writer.file_),
                                            current_offset_(writer.current_offset_),
                                            state_(writer.state_),
                                            files_(std::move(writer.files_)),
+                                           compression_level_(writer.compression_level_),
+                                           compression_threads_(writer.compression_threads_),
                                            z_stream_(std::move(writer.z_stream_)),
-                                           buffer_(std::move(writer.buffer_)){
+                                           buffer_(std::move(writer.buffer_)),
+                                           parallel_(std::move(writer.parallel_)) {
   writer.file_ = nullptr;
   writer.state_ = State::kError;
 }
@@ -101,16 +152,39 @@ ZipWriter& ZipWriter::operator=(ZipWriter&& writer) {
   current_offset_ = writer.current_offset_;
   state_ = writer.state_;
   files_ = std::move(writer.files_);
+  compression_level_ = writer.compression_level_;
+  compression_threads_ = writer.compression_threads_;
   z_stream_ = std::move(writer.z_stream_);
   buffer_ = std::move(writer.buffer_);
+  parallel_ = std::move(writer.parallel_);
   writer.file_ = nullptr;
   writer.state_ = State::kError;
   return *this;
 }
 
+ZipWriter::~ZipWriter() {
+}
+
+int32_t ZipWriter::SetCompressionLevel(int level) {
+  if (level < Z_NO_COMPRESSION || level > Z_BEST_COMPRESSION) {
+    return kInvalidCompressionLevel;
+  }
+  compression_level_ = level;
+  return kNoError;
+}
+
+void ZipWriter::SetCompressionThreads(size_t threads) {
+#if defined(_WIN32)
+  // The Windows toolchain has no std::async.
+  threads = 1;
+#endif
+  compression_threads_ = std::max(threads, static_cast<size_t>(1));
+}
+
 int32_t ZipWriter::HandleError(int32_t error_code) {
   state_ = State::kError;
   z_stream_.reset();
+  parallel_.reset();
   return error_code;
 }
 
@@ -240,10 +314,16 @@ int32_t ZipWriter::StartAlignedEntryWithTime(const char* path, size_t flags,
 int32_t ZipWriter::PrepareDeflate() {
   assert(state_ == State::kWritingZip);
 
+  if (compression_threads_ > 1) {
+    // Each chunk gets its own z_stream when it is deflated.
+    parallel_.reset(new ParallelDeflate(compression_level_, compression_threads_));
+    return kNoError;
+  }
+
   // Initialize the z_stream for compression.
   z_stream_ = std::unique_ptr<z_stream, void(*)(z_stream*)>(new z_stream(), DeleteZStream);
 
-  int zerr = deflateInit2(z_stream_.get(), Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+  int zerr = deflateInit2(z_stream_.get(), compression_level_, Z_DEFLATED, -MAX_WBITS,
                           DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
   if (zerr != Z_OK) {
     if (zerr == Z_VERSION_ERROR) {
@@ -277,7 +357,10 @@ int32_t ZipWriter::WriteBytes(const void* data, size_t len) {
     return result;
   }
 
-  currentFile.crc32 = crc32(currentFile.crc32, reinterpret_cast<const Bytef*>(data), len);
+  if (!parallel_) {
+    // Chunks carry their own CRC, computed on the thread that deflates them.
+    currentFile.crc32 = crc32(currentFile.crc32, reinterpret_cast<const Bytef*>(data), len);
+  }
   currentFile.uncompressed_size += len;
   return kNoError;
 }
@@ -295,6 +378,25 @@ int32_t ZipWriter::StoreBytes(FileInfo* file, const void* data, size_t len) {
 
 int32_t ZipWriter::CompressBytes(FileInfo* file, const void* data, size_t len) {
   assert(state_ == State::kWritingEntry);
+
+  if (parallel_) {
+    // Fill the current chunk, sending it off to be deflated whenever it is full.
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    while (len > 0) {
+      size_t count = std::min(len, kChunkSize - parallel_->input.size());
+      parallel_->input.insert(parallel_->input.end(), bytes, bytes + count);
+      bytes += count;
+      len -= count;
+      if (parallel_->input.size() == kChunkSize) {
+        int32_t result = QueueChunk(file, false);
+        if (result != kNoError) {
+          return result;
+        }
+      }
+    }
+    return kNoError;
+  }
+
   assert(z_stream_);
   assert(z_stream_->next_out != nullptr);
   assert(z_stream_->avail_out != 0);
@@ -329,6 +431,16 @@ int32_t ZipWriter::CompressBytes(FileInfo* file, const void* data, size_t len) {
 
 int32_t ZipWriter::FlushCompressedBytes(FileInfo* file) {
   assert(state_ == State::kWritingEntry);
+
+  if (parallel_) {
+    int32_t result = QueueChunk(file, true);
+    if (result != kNoError) {
+      return result;
+    }
+    parallel_.reset();
+    return kNoError;
+  }
+
   assert(z_stream_);
   assert(z_stream_->next_out != nullptr);
   assert(z_stream_->avail_out != 0);
@@ -364,6 +476,110 @@ int32_t ZipWriter::FlushCompressedBytes(FileInfo* file) {
   return kNoError;
 }
 
+ZipWriter::DeflatedChunk ZipWriter::DeflateChunk(std::vector<uint8_t> input,
+                                                 std::vector<uint8_t> dictionary,
+                                                 int level, bool last) {
+  DeflatedChunk chunk = {};
+  chunk.crc32 = crc32(0, input.data(), input.size());
+  chunk.uncompressed_size = input.size();
+
+  z_stream stream = {};
+  if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return chunk;
+  }
+  std::unique_ptr<z_stream, int(*)(z_stream*)> stream_guard(&stream, deflateEnd);
+
+  // Compress as if the chunk followed on from the previous one, which it does.
+  if (!dictionary.empty() &&
+      deflateSetDictionary(&stream, dictionary.data(), dictionary.size()) != Z_OK) {
+    return chunk;
+  }
+
+  // All but the last chunk end with a sync flush instead of a final block: the output is
+  // then byte aligned, and the next chunk carries on the same deflate stream.
+  const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  chunk.data.resize(deflateBound(&stream, input.size()) + 16);
+  stream.next_in = input.data();
+  stream.avail_in = input.size();
+  stream.next_out = chunk.data.data();
+  stream.avail_out = chunk.data.size();
+  while (true) {
+    int zerr = deflate(&stream, flush);
+    if (last ? (zerr == Z_STREAM_END) : (zerr == Z_OK && stream.avail_out != 0)) {
+      break;
+    }
+    if ((zerr != Z_OK && zerr != Z_BUF_ERROR) || stream.avail_out != 0) {
+      return chunk;
+    }
+
+    // Out of room, grow the output and carry on.
+    size_t used = chunk.data.size();
+    chunk.data.resize(used * 2);
+    stream.next_out = chunk.data.data() + used;
+    stream.avail_out = chunk.data.size() - used;
+  }
+  chunk.data.resize(stream.next_out - chunk.data.data());
+  chunk.ok = true;
+  return chunk;
+}
+
+int32_t ZipWriter::QueueChunk(FileInfo* file, bool last) {
+#if !defined(_WIN32)
+  ParallelDeflate* parallel = parallel_.get();
+
+  // Keep one chunk per thread in flight, writing out the oldest to make room.
+  if (parallel->pending.size() >= parallel->threads) {
+    DeflatedChunk chunk = parallel->pending.front().get();
+    parallel->pending.pop_front();
+    int32_t result = WriteChunk(file, chunk);
+    if (result != kNoError) {
+      return result;
+    }
+  }
+
+  std::vector<uint8_t> dictionary(std::move(parallel->dictionary));
+  size_t dictionary_size = std::min(parallel->input.size(), kDictionarySize);
+  parallel->dictionary.assign(parallel->input.end() - dictionary_size, parallel->input.end());
+  parallel->pending.push_back(std::async(std::launch::async, DeflateChunk,
+                                         std::move(parallel->input), std::move(dictionary),
+                                         parallel->level, last));
+  parallel->input.clear();
+  parallel->input.reserve(kChunkSize);
+
+  if (last) {
+    while (!parallel->pending.empty()) {
+      DeflatedChunk chunk = parallel->pending.front().get();
+      parallel->pending.pop_front();
+      int32_t result = WriteChunk(file, chunk);
+      if (result != kNoError) {
+        return result;
+      }
+    }
+  }
+  return kNoError;
+#else
+  // SetCompressionThreads() never enables chunks on Windows.
+  (void) file;
+  (void) last;
+  return HandleError(kInvalidState);
+#endif
+}
+
+int32_t ZipWriter::WriteChunk(FileInfo* file, const DeflatedChunk& chunk) {
+  if (!chunk.ok) {
+    return HandleError(kZlibError);
+  }
+
+  if (fwrite(chunk.data.data(), 1, chunk.data.size(), file_) != chunk.data.size()) {
+    return HandleError(kIoError);
+  }
+  file->compressed_size += chunk.data.size();
+  current_offset_ += chunk.data.size();
+  file->crc32 = crc32_combine(file->crc32, chunk.crc32, chunk.uncompressed_size);
+  return kNoError;
+}
+
 int32_t ZipWriter::FinishEntry() {
   if (state_ != State::kWritingEntry) {
     return kInvalidState;
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ziparchive/zip_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+static constexpr size_t kEntrySize = 16 * 1024 * 1024;
+
+// Random bytes from a small alphabet, which deflate works hard to shrink to about 60%.
+static const std::vector<uint8_t>& EntryData() {
+  static std::vector<uint8_t> data;
+  if (data.empty()) {
+    data.resize(kEntrySize);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < data.size(); i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (seed >> 16) % 24;
+    }
+  }
+  return data;
+}
+
+// Writes one compressed entry at level range_x() on range_y() threads. The archive goes
+// to /dev/null, so the time is all compression.
+static void BM_ZipWriter_compress(benchmark::State& state) {
+  const std::vector<uint8_t>& data = EntryData();
+  FILE* file = fopen("/dev/null", "wb");
+  if (file == nullptr) {
+    abort();
+  }
+
+  while (state.KeepRunning()) {
+    ZipWriter writer(file);
+    writer.SetCompressionLevel(state.range_x());
+    writer.SetCompressionThreads(state.range_y());
+    if (writer.StartEntry("entry.bin", ZipWriter::kCompress) != 0 ||
+        writer.WriteBytes(data.data(), data.size()) != 0 ||
+        writer.FinishEntry() != 0 ||
+        writer.Finish() != 0) {
+      abort();
+    }
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+
+  fclose(file);
+}
+BENCHMARK(BM_ZipWriter_compress)
+    ->ArgPair(1, 1)->ArgPair(1, 4)
+    ->ArgPair(6, 1)->ArgPair(6, 4)
+    ->ArgPair(9, 1)->ArgPair(9, 2)->ArgPair(9, 4)->ArgPair(9, 8)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -17,10 +17,13 @@
 #include "ziparchive/zip_archive.h"
 #include "ziparchive/zip_writer.h"
 
+#include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 #include <time.h>
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <vector>
 
 struct zipwriter : public ::testing::Test {
@@ -313,9 +316,138 @@ TEST_F(zipwriter, WriteCompressedZipFlushFull) {
   CloseArchive(handle);
 }
 
+static std::vector<uint8_t> MakeCompressibleData(size_t size) {
+  // Repetitive, but not so much that every chunk compresses to nothing.
+  std::vector<uint8_t> data(size);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < size; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = "abcdefgh"[(seed >> 16) & 7];
+  }
+  return data;
+}
+
+TEST_F(zipwriter, WriteCompressedZipOnSeveralThreads) {
+  // Several chunks, written in pieces that don't line up with them.
+  const std::vector<uint8_t> buffer = MakeCompressibleData(1000000);
+
+  ZipWriter writer(file_);
+  writer.SetCompressionThreads(4);
+  ASSERT_EQ(0, writer.StartEntry("file.txt", ZipWriter::kCompress));
+  for (size_t offset = 0; offset < buffer.size(); offset += 77777) {
+    size_t len = std::min(buffer.size() - offset, static_cast<size_t>(77777));
+    ASSERT_EQ(0, writer.WriteBytes(buffer.data() + offset, len));
+  }
+  ASSERT_EQ(0, writer.FinishEntry());
+  ASSERT_EQ(0, writer.StartEntry("empty.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.FinishEntry());
+  ASSERT_EQ(0, writer.Finish());
+
+  ASSERT_GE(0, lseek(fd_, 0, SEEK_SET));
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd_, "temp", &handle, false));
+
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, ZipString("file.txt"), &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  EXPECT_EQ(buffer.size(), data.uncompressed_length);
+  EXPECT_LT(data.compressed_length, buffer.size() / 2);
+  EXPECT_EQ(crc32(0, buffer.data(), buffer.size()), data.crc32);
+
+  std::vector<uint8_t> decompress(buffer.size());
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, decompress.data(), decompress.size()));
+  EXPECT_EQ(0, memcmp(decompress.data(), buffer.data(), buffer.size()))
+      << "Input buffer and output buffer are different.";
+
+  ASSERT_EQ(0, FindEntry(handle, ZipString("empty.txt"), &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  EXPECT_EQ(0u, data.uncompressed_length);
+  EXPECT_EQ(0u, data.crc32);
+  uint8_t empty;
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, &empty, 0));
+
+  CloseArchive(handle);
+}
+
+TEST_F(zipwriter, WriteCompressedZipThreadsDontChangeOutput) {
+  const std::vector<uint8_t> buffer = MakeCompressibleData(700000);
+
+  std::vector<std::string> outputs;
+  for (size_t threads : {2, 3, 8}) {
+    TemporaryFile tf;
+    FILE* file = fdopen(dup(tf.fd), "w");
+    ASSERT_NE(file, nullptr);
+
+    ZipWriter writer(file);
+    writer.SetCompressionThreads(threads);
+    ASSERT_EQ(0, writer.StartEntryWithTime("file.txt", ZipWriter::kCompress, 0));
+    ASSERT_EQ(0, writer.WriteBytes(buffer.data(), buffer.size()));
+    ASSERT_EQ(0, writer.FinishEntry());
+    ASSERT_EQ(0, writer.Finish());
+    fclose(file);
+
+    std::string output;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &output));
+    outputs.push_back(output);
+  }
+  EXPECT_EQ(outputs[0], outputs[1]);
+  EXPECT_EQ(outputs[0], outputs[2]);
+}
+
+TEST_F(zipwriter, WriteCompressedZipWithLevels) {
+  const std::vector<uint8_t> buffer = MakeCompressibleData(100000);
+
+  ZipWriter writer(file_);
+  ASSERT_GT(0, writer.SetCompressionLevel(-1));
+  int32_t error = writer.SetCompressionLevel(10);
+  ASSERT_GT(0, error);
+  EXPECT_STREQ("Invalid compression level", ZipWriter::ErrorCodeString(error));
+
+  ASSERT_EQ(0, writer.SetCompressionLevel(Z_NO_COMPRESSION));
+  ASSERT_EQ(0, writer.StartEntry("stored.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.WriteBytes(buffer.data(), buffer.size()));
+  ASSERT_EQ(0, writer.FinishEntry());
+
+  ASSERT_EQ(0, writer.SetCompressionLevel(Z_BEST_SPEED));
+  ASSERT_EQ(0, writer.StartEntry("fast.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.WriteBytes(buffer.data(), buffer.size()));
+  ASSERT_EQ(0, writer.FinishEntry());
+  ASSERT_EQ(0, writer.Finish());
+
+  ASSERT_GE(0, lseek(fd_, 0, SEEK_SET));
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd_, "temp", &handle, false));
+
+  std::vector<uint8_t> decompress(buffer.size());
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, ZipString("stored.txt"), &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  EXPECT_GT(data.compressed_length, buffer.size());
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, decompress.data(), decompress.size()));
+  EXPECT_EQ(0, memcmp(decompress.data(), buffer.data(), buffer.size()));
+
+  ASSERT_EQ(0, FindEntry(handle, ZipString("fast.txt"), &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  EXPECT_LT(data.compressed_length, buffer.size() / 2);
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, decompress.data(), decompress.size()));
+  EXPECT_EQ(0, memcmp(decompress.data(), buffer.data(), buffer.size()));
+
+  CloseArchive(handle);
+}
+
 TEST_F(zipwriter, CheckStartEntryErrors) {
   ZipWriter writer(file_);
 
   ASSERT_EQ(-5, writer.StartAlignedEntry("align.txt", ZipWriter::kAlign32, 4096));
   ASSERT_EQ(-6, writer.StartAlignedEntry("align.txt", 0, 3));
 }
+
+TEST_F(zipwriter, ErrorCodeString) {
+  EXPECT_STREQ("No error", ZipWriter::ErrorCodeString(0));
+  EXPECT_STREQ("Invalid state", ZipWriter::ErrorCodeString(-1));
+  EXPECT_STREQ("Alignment is not a power of 2", ZipWriter::ErrorCodeString(-6));
+  EXPECT_STREQ("Invalid compression level", ZipWriter::ErrorCodeString(-7));
+  EXPECT_EQ(nullptr, ZipWriter::ErrorCodeString(-8));
+}
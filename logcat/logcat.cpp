@@ -19,11 +19,17 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/strings.h>
@@ -41,6 +47,17 @@
 
 #define DEFAULT_MAX_ROTATED_LOGS 4
 
+/* size of the buffer that collects formatted output between writes */
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+/* flush before formatting a line if less than this is left in the buffer */
+#define OUTPUT_BUFFER_MIN_FREE 4096
+
+/* entries handed to a pipeline worker at a time */
+#define PIPELINE_BATCH_SIZE 256
+/* batches in flight per pipeline worker */
+#define PIPELINE_BATCHES_PER_THREAD 2
+#define PIPELINE_MAX_THREADS 32
+
 static AndroidLogFormat * g_logformat;
 
 /* logd prefixes records with a length field */
@@ -76,6 +93,13 @@ static size_t g_logRotateSizeKBytes;
 static size_t g_maxRotatedLogs = DEFAULT_MAX_ROTATED_LOGS;
 static int g_outFD = -1;
 static size_t g_outByteCount;
+// 0 means "no log rotation", otherwise g_logRotateSizeKBytes in bytes
+static size_t g_logRotateSizeBytes;
+// Output is only held back when reading will not block for new entries,
+// otherwise every line is written out as soon as it has been formatted.
+static bool g_outBuffered;
+static char g_outBuffer[OUTPUT_BUFFER_SIZE];
+static size_t g_outBufferLen;
 static int g_printBinary;
 static int g_devCount;                              // >1 means multiple
 static pcrecpp::RE* g_regex;
@@ -83,6 +107,11 @@ static pcrecpp::RE* g_regex;
 static size_t g_maxCount;
 static size_t g_printCount;
 static bool g_printItAnyways;
+// >1 decodes, filters and formats entries on that many worker threads
+static size_t g_pipelineThreads;
+// Arguments applied to g_logformat, replayed onto the worker formats
+static std::vector<std::string> g_formatStrings;
+static std::vector<std::string> g_filterStrings;
 
 // if showHelp is set, newline required in fmt statement to transition to usage
 __noreturn static void logcat_panic(bool showHelp, const char *fmt, ...) __printflike(2,3);
@@ -92,6 +121,88 @@ static int openLogFile (const char *pathname)
     return open(pathname, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
 }
 
+// Writes out the pending output followed by the optional extra data,
+// returns false if the output could not be written
+static bool flushOutput(const char *extra = NULL, size_t extraLen = 0)
+{
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    if (g_outBufferLen) {
+        iov[iovcnt].iov_base = g_outBuffer;
+        iov[iovcnt].iov_len = g_outBufferLen;
+        ++iovcnt;
+    }
+    if (extraLen) {
+        iov[iovcnt].iov_base = const_cast<char *>(extra);
+        iov[iovcnt].iov_len = extraLen;
+        ++iovcnt;
+    }
+    g_outBufferLen = 0;
+
+    struct iovec *vec = iov;
+    while (iovcnt) {
+        ssize_t ret = TEMP_FAILURE_RETRY(writev(g_outFD, vec, iovcnt));
+        if (ret < 0) {
+            return false;
+        }
+        while (iovcnt && ((size_t)ret >= vec->iov_len)) {
+            ret -= vec->iov_len;
+            ++vec;
+            --iovcnt;
+        }
+        if (iovcnt) {
+            vec->iov_base = static_cast<char *>(vec->iov_base) + ret;
+            vec->iov_len -= ret;
+        }
+    }
+    return true;
+}
+
+static bool writeOutput(const char *buf, size_t len)
+{
+    if (!g_outBuffered || (len > (sizeof(g_outBuffer) - g_outBufferLen))) {
+        return flushOutput(buf, len);
+    }
+    memcpy(g_outBuffer + g_outBufferLen, buf, len);
+    g_outBufferLen += len;
+    return true;
+}
+
+// Formats the entry straight into the output buffer, returns the line length
+// or -1 if it could not be formatted or written
+static int printLogLine(const AndroidLogEntry *entry)
+{
+    if ((sizeof(g_outBuffer) - g_outBufferLen) < OUTPUT_BUFFER_MIN_FREE) {
+        if (!flushOutput()) {
+            return -1;
+        }
+    }
+
+    char *tail = g_outBuffer + g_outBufferLen;
+    size_t len;
+    char *line = android_log_formatLogLine(g_logformat, tail,
+                                           sizeof(g_outBuffer) - g_outBufferLen,
+                                           entry, &len);
+    if (!line) {
+        return -1;
+    }
+
+    bool written = true;
+    if (line == tail) {
+        g_outBufferLen += len;
+        if (!g_outBuffered) {
+            written = flushOutput();
+        }
+    } else {
+        // Did not fit, write it out behind whatever is pending
+        written = flushOutput(line, len);
+        free(line);
+    }
+
+    return written ? len : -1;
+}
+
 static void rotateLogs()
 {
     int err;
@@ -101,6 +212,9 @@ static void rotateLogs()
         return;
     }
 
+    if (!flushOutput()) {
+        logcat_panic(false, "output error");
+    }
     close(g_outFD);
 
     // Compute the maximum number of digits needed to count up to g_maxRotatedLogs in decimal.
@@ -146,9 +260,9 @@ static void rotateLogs()
 
 void printBinary(struct log_msg *buf)
 {
-    size_t size = buf->len();
-
-    TEMP_FAILURE_RETRY(write(g_outFD, buf, size));
+    if (!writeOutput(reinterpret_cast<const char *>(buf), buf->len())) {
+        logcat_panic(false, "output error");
+    }
 }
 
 static bool regexOk(const AndroidLogEntry& entry)
@@ -162,6 +276,31 @@ static bool regexOk(const AndroidLogEntry& entry)
     return g_regex->PartialMatch(messageString);
 }
 
+static EventTagMap *getEventTagMap()
+{
+    static bool hasOpenedEventTagMap = false;
+    static EventTagMap *eventTagMap = NULL;
+
+    if (!eventTagMap && !hasOpenedEventTagMap) {
+        eventTagMap = android_openEventTagMap(EVENT_TAG_MAP_FILE);
+        hasOpenedEventTagMap = true;
+    }
+    return eventTagMap;
+}
+
+static int decodeBuffer(bool binary, struct log_msg *buf,
+                        AndroidLogEntry *entry,
+                        char *binaryMsgBuf, size_t binaryMsgBufLen)
+{
+    if (binary) {
+        return android_log_processBinaryLogBuffer(&buf->entry_v1, entry,
+                                                  getEventTagMap(),
+                                                  binaryMsgBuf,
+                                                  binaryMsgBufLen);
+    }
+    return android_log_processLogBuffer(&buf->entry_v1, entry);
+}
+
 static void processBuffer(log_device_t* dev, struct log_msg *buf)
 {
     int bytesWritten = 0;
@@ -169,23 +308,8 @@ static void processBuffer(log_device_t* dev, struct log_msg *buf)
     AndroidLogEntry entry;
     char binaryMsgBuf[1024];
 
-    if (dev->binary) {
-        static bool hasOpenedEventTagMap = false;
-        static EventTagMap *eventTagMap = NULL;
-
-        if (!eventTagMap && !hasOpenedEventTagMap) {
-            eventTagMap = android_openEventTagMap(EVENT_TAG_MAP_FILE);
-            hasOpenedEventTagMap = true;
-        }
-        err = android_log_processBinaryLogBuffer(&buf->entry_v1, &entry,
-                                                 eventTagMap,
-                                                 binaryMsgBuf,
-                                                 sizeof(binaryMsgBuf));
-        //printf(">>> pri=%d len=%d msg='%s'\n",
-        //    entry.priority, entry.messageLen, entry.message);
-    } else {
-        err = android_log_processLogBuffer(&buf->entry_v1, &entry);
-    }
+    err = decodeBuffer(dev->binary, buf, &entry,
+                       binaryMsgBuf, sizeof(binaryMsgBuf));
     if (err < 0) {
         goto error;
     }
@@ -195,7 +319,7 @@ static void processBuffer(log_device_t* dev, struct log_msg *buf)
 
         g_printCount += match;
         if (match || g_printItAnyways) {
-            bytesWritten = android_log_printLogLine(g_logformat, g_outFD, &entry);
+            bytesWritten = printLogLine(&entry);
 
             if (bytesWritten < 0) {
                 logcat_panic(false, "output error");
@@ -205,9 +329,7 @@ static void processBuffer(log_device_t* dev, struct log_msg *buf)
 
     g_outByteCount += bytesWritten;
 
-    if (g_logRotateSizeKBytes > 0
-        && (g_outByteCount / 1024) >= g_logRotateSizeKBytes
-    ) {
+    if (g_logRotateSizeBytes && (g_outByteCount >= g_logRotateSizeBytes)) {
         rotateLogs();
     }
 
@@ -223,7 +345,7 @@ static void maybePrintStart(log_device_t* dev, bool printDividers) {
             snprintf(buf, sizeof(buf), "--------- %s %s\n",
                      dev->printed ? "switch to" : "beginning of",
                      dev->device);
-            if (write(g_outFD, buf, strlen(buf)) < 0) {
+            if (!writeOutput(buf, strlen(buf))) {
                 logcat_panic(false, "output error");
             }
         }
@@ -231,6 +353,310 @@ static void maybePrintStart(log_device_t* dev, bool printDividers) {
     }
 }
 
+
+static bool readLogMsg(struct logger_list *logger_list, struct log_msg *log_msg)
+{
+    int ret = android_logger_list_read(logger_list, log_msg);
+
+    if (ret == 0) {
+        logcat_panic(false, "read: unexpected EOF!\n");
+    }
+
+    if (ret < 0) {
+        if (ret == -EAGAIN) {
+            return false;
+        }
+
+        if (ret == -EIO) {
+            logcat_panic(false, "read: unexpected EOF!\n");
+        }
+        if (ret == -EINVAL) {
+            logcat_panic(false, "read: unexpected length.\n");
+        }
+        logcat_panic(false, "logcat read failure");
+    }
+    return true;
+}
+
+// Returns the device the entry was read from, or NULL if it was not asked for
+static log_device_t* lookupDevice(log_device_t* devices,
+                                  struct log_msg *log_msg)
+{
+    log_device_t* d;
+
+    for (d = devices; d; d = d->next) {
+        if (android_name_to_log_id(d->device) == log_msg->id()) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+// Switches to the "unexpected" device for an entry from an unknown buffer
+static log_device_t* useUnexpected(log_device_t* unexpected, bool binary)
+{
+    g_devCount = 2; // set to Multiple
+    unexpected->binary = binary;
+    return unexpected;
+}
+
+static log_device_t* findDevice(log_device_t* devices, struct log_msg *log_msg,
+                                log_device_t* unexpected)
+{
+    log_device_t* d = lookupDevice(devices, log_msg);
+    if (d) {
+        return d;
+    }
+    return useUnexpected(unexpected, log_msg->id() == LOG_ID_EVENTS);
+}
+
+/*
+ * Pipeline mode: the main thread reads entries in batches and hands them to
+ * worker threads, which decode, filter, regex match and format them into the
+ * batch. The main thread then writes the batches out in the order they were
+ * read, so the output is identical to that of the serial loop.
+ */
+struct PipelineRecord {
+    // NULL for an entry from an unexpected buffer, which only switches to
+    // the "unexpected" device once the writer gets to it
+    log_device_t* dev;
+    // copied as the "unexpected" device changes from entry to entry
+    bool binary;
+    size_t offset;
+    size_t len;
+    bool match;
+    bool print;
+};
+
+struct PipelineBatch {
+    std::vector<struct log_msg> msgs;
+    std::vector<PipelineRecord> records;
+    std::string out;
+    bool done;
+};
+
+class LogPipeline {
+  public:
+    explicit LogPipeline(size_t threads) : mStopping(false) {
+        // Formats are set up here rather than on the workers as
+        // android_log_formatFromString may change the TZ environment.
+        for (size_t i = 0; i < threads; ++i) {
+            AndroidLogFormat *format = android_log_format_new();
+            for (const auto& formatString : g_formatStrings) {
+                android_log_setPrintFormat(format,
+                        android_log_formatFromString(formatString.c_str()));
+            }
+            for (const auto& filterString : g_filterStrings) {
+                android_log_addFilterString(format, filterString.c_str());
+            }
+            mThreads.emplace_back(&LogPipeline::worker, this, format);
+        }
+    }
+
+    ~LogPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStopping = true;
+        }
+        mWork.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    void submit(PipelineBatch *batch) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            batch->done = false;
+            mQueue.push_back(batch);
+        }
+        mWork.notify_one();
+    }
+
+    void wait(PipelineBatch *batch) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mDone.wait(lock, [batch]() { return batch->done; });
+    }
+
+  private:
+    void worker(AndroidLogFormat *format) {
+        for (;;) {
+            PipelineBatch *batch;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mWork.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+                if (mQueue.empty()) {
+                    break;
+                }
+                batch = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            process(format, batch);
+
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                batch->done = true;
+            }
+            mDone.notify_all();
+        }
+        android_log_format_free(format);
+    }
+
+    static void process(AndroidLogFormat *format, PipelineBatch *batch) {
+        char binaryMsgBuf[1024];
+        char lineBuf[1024];
+
+        batch->out.clear();
+        for (size_t i = 0; i < batch->msgs.size(); ++i) {
+            PipelineRecord& record = batch->records[i];
+            AndroidLogEntry entry;
+
+            record.offset = batch->out.size();
+            record.len = 0;
+            record.match = false;
+            record.print = false;
+
+            if (decodeBuffer(record.binary, &batch->msgs[i], &entry,
+                             binaryMsgBuf, sizeof(binaryMsgBuf)) < 0) {
+                continue;
+            }
+            if (!android_log_shouldPrintLine(format, entry.tag, entry.priority)) {
+                continue;
+            }
+            record.match = regexOk(entry);
+            if (!record.match && !g_printItAnyways) {
+                continue;
+            }
+
+            size_t len;
+            char *line = android_log_formatLogLine(format, lineBuf, sizeof(lineBuf),
+                                                   &entry, &len);
+            if (!line) {
+                continue;
+            }
+            batch->out.append(line, len);
+            if (line != lineBuf) {
+                free(line);
+            }
+            record.len = len;
+            record.print = true;
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mWork;
+    std::condition_variable mDone;
+    std::deque<PipelineBatch *> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mStopping;
+};
+
+// Returns true if the worker formats would produce the same output as
+// g_logformat. Conversion to monotonic time relies on global state in
+// liblog that is not safe to use from several threads.
+static bool pipelineSupported()
+{
+    if (android_log_clockid() == CLOCK_MONOTONIC) {
+        return true;
+    }
+    for (const auto& formatString : g_formatStrings) {
+        if (formatString == "monotonic") {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void runPipeline(struct logger_list *logger_list, log_device_t* devices,
+                        log_device_t* unexpected, bool printDividers)
+{
+    size_t inFlight = g_pipelineThreads * PIPELINE_BATCHES_PER_THREAD;
+    std::vector<PipelineBatch> batches(inFlight);
+    std::deque<PipelineBatch *> pending;
+    log_device_t* dev = NULL;
+    bool eof = false;
+
+    // Open the event tag map before any worker needs it.
+    getEventTagMap();
+
+    LogPipeline pipeline(g_pipelineThreads);
+
+    for (auto& batch : batches) {
+        batch.msgs.resize(PIPELINE_BATCH_SIZE);
+        batch.records.resize(PIPELINE_BATCH_SIZE);
+    }
+
+    size_t next = 0;
+    while (!g_maxCount || (g_printCount < g_maxCount)) {
+        while (!eof && (pending.size() < inFlight)) {
+            PipelineBatch *batch = &batches[next];
+            next = (next + 1) % inFlight;
+
+            size_t count = 0;
+            batch->msgs.resize(PIPELINE_BATCH_SIZE);
+            while (count < PIPELINE_BATCH_SIZE) {
+                if (!readLogMsg(logger_list, &batch->msgs[count])) {
+                    eof = true;
+                    break;
+                }
+                PipelineRecord& record = batch->records[count];
+                record.dev = lookupDevice(devices, &batch->msgs[count]);
+                record.binary = record.dev ? record.dev->binary
+                    : (batch->msgs[count].id() == LOG_ID_EVENTS);
+                ++count;
+            }
+            if (!count) {
+                break;
+            }
+            batch->msgs.resize(count);
+            pipeline.submit(batch);
+            pending.push_back(batch);
+        }
+
+        if (pending.empty()) {
+            break;
+        }
+
+        PipelineBatch *batch = pending.front();
+        pending.pop_front();
+        pipeline.wait(batch);
+
+        for (size_t i = 0; i < batch->msgs.size(); ++i) {
+            if (g_maxCount && (g_printCount >= g_maxCount)) {
+                break;
+            }
+            const PipelineRecord& record = batch->records[i];
+            log_device_t* d = record.dev;
+            if (!d) {
+                d = useUnexpected(unexpected, record.binary);
+            }
+            if (dev != d) {
+                dev = d;
+                maybePrintStart(dev, printDividers);
+            }
+            g_printCount += record.match;
+            if (!record.print) {
+                continue;
+            }
+            if (!writeOutput(batch->out.data() + record.offset, record.len)) {
+                logcat_panic(false, "output error");
+            }
+            g_outByteCount += record.len;
+            if (g_logRotateSizeBytes
+                    && (g_outByteCount >= g_logRotateSizeBytes)) {
+                rotateLogs();
+            }
+        }
+    }
+
+    // Let the workers finish with what is still queued before the batches
+    // go away.
+    for (PipelineBatch *batch : pending) {
+        pipeline.wait(batch);
+    }
+}
+
 static void setupOutput()
 {
 
@@ -330,6 +756,9 @@ static void show_help(const char *cmd)
                     "                  Set prune white and ~black list, using same format as\n"
                     "                  listed above. Must be quoted.\n"
                     "  --pid=<pid>     Only prints logs from the given pid.\n"
+                    "  --threads=<count>\n"
+                    "                  Decode, filter and format on <count> threads when dumping\n"
+                    "                  the log (-d, -t). Output order is unchanged.\n"
                     // Check ANDROID_LOG_WRAP_DEFAULT_TIMEOUT value for match to 2 hours
                     "  --wrap          Sleep for 2 hours or when buffer about to wrap whichever\n"
                     "                  comes first. Improves efficiency of polling by providing\n"
@@ -364,9 +793,20 @@ static int setLogFormat(const char * formatString)
         return -1;
     }
 
+    g_formatStrings.push_back(formatString);
     return android_log_setPrintFormat(g_logformat, format);
 }
 
+static int addFilterString(const char * filterString)
+{
+    int err = android_log_addFilterString(g_logformat, filterString);
+
+    if (err >= 0) {
+        g_filterStrings.push_back(filterString);
+    }
+    return err;
+}
+
 static const char multipliers[][2] = {
     { "" },
     { "K" },
@@ -417,6 +857,9 @@ static bool getSizeTArg(char *ptr, size_t *val, size_t min = 0,
 
 static void logcat_panic(bool showHelp, const char *fmt, ...)
 {
+    // do not lose what has already been formatted, if it can still be written
+    flushOutput();
+
     va_list  args;
     va_start(args, fmt);
     vfprintf(stderr, fmt,  args);
@@ -575,6 +1018,7 @@ int main(int argc, char **argv)
         static const char pid_str[] = "pid";
         static const char wrap_str[] = "wrap";
         static const char print_str[] = "print";
+        static const char threads_str[] = "threads";
         static const struct option long_options[] = {
           { "binary",        no_argument,       NULL,   'B' },
           { "buffer",        required_argument, NULL,   'b' },
@@ -598,6 +1042,7 @@ int main(int argc, char **argv)
           { "statistics",    no_argument,       NULL,   'S' },
           // hidden and undocumented reserved alias for -t
           { "tail",          required_argument, NULL,   't' },
+          { threads_str,     required_argument, NULL,   0 },
           // support, but ignore and do not document, the optional argument
           { wrap_str,        optional_argument, NULL,   0 },
           { NULL,            0,                 NULL,   0 }
@@ -643,11 +1088,19 @@ int main(int argc, char **argv)
                     g_printItAnyways = true;
                     break;
                 }
+                if (long_options[option_index].name == threads_str) {
+                    if (!getSizeTArg(optarg, &g_pipelineThreads, 1,
+                                     PIPELINE_MAX_THREADS)) {
+                        logcat_panic(true, "%s %s out of range\n",
+                                     long_options[option_index].name, optarg);
+                    }
+                    break;
+                }
             break;
 
             case 's':
                 // default to all silent
-                android_log_addFilterRule(g_logformat, "*:s");
+                addFilterString("*:s");
             break;
 
             case 'c':
@@ -984,7 +1437,7 @@ int main(int argc, char **argv)
     }
 
     if (forceFilters) {
-        err = android_log_addFilterString(g_logformat, forceFilters);
+        err = addFilterString(forceFilters);
         if (err < 0) {
             logcat_panic(false, "Invalid filter expression in logcat args\n");
         }
@@ -993,7 +1446,7 @@ int main(int argc, char **argv)
         char *env_tags_orig = getenv("ANDROID_LOG_TAGS");
 
         if (env_tags_orig != NULL) {
-            err = android_log_addFilterString(g_logformat, env_tags_orig);
+            err = addFilterString(env_tags_orig);
 
             if (err < 0) {
                 logcat_panic(true,
@@ -1003,7 +1456,7 @@ int main(int argc, char **argv)
     } else {
         // Add from commandline
         for (int i = optind ; i < argc ; i++) {
-            err = android_log_addFilterString(g_logformat, argv[i]);
+            err = addFilterString(argv[i]);
 
             if (err < 0) {
                 logcat_panic(true, "Invalid filter expression '%s'\n", argv[i]);
@@ -1194,51 +1647,36 @@ int main(int argc, char **argv)
     dev = NULL;
     log_device_t unexpected("unexpected", false);
 
-    while (!g_maxCount || (g_printCount < g_maxCount)) {
-        struct log_msg log_msg;
-        log_device_t* d;
-        int ret = android_logger_list_read(logger_list, &log_msg);
+    g_outBuffered = (mode & ANDROID_LOG_NONBLOCK) != 0;
+    g_logRotateSizeBytes = g_logRotateSizeKBytes * 1024;
 
-        if (ret == 0) {
-            logcat_panic(false, "read: unexpected EOF!\n");
-        }
+    if ((g_pipelineThreads > 1) && g_outBuffered && !g_printBinary
+            && pipelineSupported()) {
+        runPipeline(logger_list, devices, &unexpected, printDividers);
+    } else {
+        while (!g_maxCount || (g_printCount < g_maxCount)) {
+            struct log_msg log_msg;
 
-        if (ret < 0) {
-            if (ret == -EAGAIN) {
+            if (!readLogMsg(logger_list, &log_msg)) {
                 break;
             }
 
-            if (ret == -EIO) {
-                logcat_panic(false, "read: unexpected EOF!\n");
+            log_device_t* d = findDevice(devices, &log_msg, &unexpected);
+            if (dev != d) {
+                dev = d;
+                maybePrintStart(dev, printDividers);
             }
-            if (ret == -EINVAL) {
-                logcat_panic(false, "read: unexpected length.\n");
-            }
-            logcat_panic(false, "logcat read failure");
-        }
-
-        for (d = devices; d; d = d->next) {
-            if (android_name_to_log_id(d->device) == log_msg.id()) {
-                break;
+            if (g_printBinary) {
+                printBinary(&log_msg);
+            } else {
+                processBuffer(dev, &log_msg);
             }
         }
-        if (!d) {
-            g_devCount = 2; // set to Multiple
-            d = &unexpected;
-            d->binary = log_msg.id() == LOG_ID_EVENTS;
-        }
-
-        if (dev != d) {
-            dev = d;
-            maybePrintStart(dev, printDividers);
-        }
-        if (g_printBinary) {
-            printBinary(&log_msg);
-        } else {
-            processBuffer(dev, &log_msg);
-        }
     }
 
+    if (!flushOutput()) {
+        logcat_panic(false, "output error");
+    }
     android_logger_list_free(logger_list);
 
     return EXIT_SUCCESS;
@@ -60,20 +60,51 @@ bool LogAudit::onDataAvailable(SocketClient *cli) {
     }
 
     struct audit_message rep;
+    reply_t block = GET_REPLY_BLOCKING;
+    bool ret = true;
+    size_t count;
+
+    // Drain replies already queued, so a burst of denials is added to the
+    // buffer under one lock per commitRecords rather than one per record.
+    // Stop after maxRecords and leave the rest for the next wakeup, so
+    // readers are not held off for the length of an unbounded burst.
+    static const size_t commitRecords = 64;
+    static const size_t maxRecords = 4 * commitRecords;
+    for (count = 0; count < maxRecords; ++count) {
+        rep.nlh.nlmsg_type = 0;
+        rep.nlh.nlmsg_len = 0;
+        rep.data[0] = '\0';
+
+        if (audit_get_reply(cli->getSocket(), &rep, block, 0) < 0) {
+            SLOGE("Failed on audit_get_reply with error: %s", strerror(errno));
+            ret = false;
+            break;
+        }
+        if (!rep.nlh.nlmsg_len) {
+            // nothing more queued
+            break;
+        }
 
-    rep.nlh.nlmsg_type = 0;
-    rep.nlh.nlmsg_len = 0;
-    rep.data[0] = '\0';
+        logPrint("type=%d %.*s",
+            rep.nlh.nlmsg_type, rep.nlh.nlmsg_len, rep.data);
+        block = GET_REPLY_NONBLOCKING;
 
-    if (audit_get_reply(cli->getSocket(), &rep, GET_REPLY_BLOCKING, 0) < 0) {
-        SLOGE("Failed on audit_get_reply with error: %s", strerror(errno));
-        return false;
+        if (((count + 1) % commitRecords) == 0) {
+            commit();
+        }
     }
 
-    logPrint("type=%d %.*s",
-        rep.nlh.nlmsg_type, rep.nlh.nlmsg_len, rep.data);
+    if (count % commitRecords) {
+        commit();
+    }
+    return ret;
+}
 
-    return true;
+void LogAudit::commit() {
+    // notify readers
+    if (logbuf->commit()) {
+        reader->notifyNewLog();
+    }
 }
 
 int LogAudit::logPrint(const char *fmt, ...) {
@@ -174,9 +205,9 @@ int LogAudit::logPrint(const char *fmt, ...) {
         event->length = htole32(l);
         memcpy(event->data, str, l);
 
-        rc = logbuf->log(LOG_ID_EVENTS, now, uid, pid, tid,
-                         reinterpret_cast<char *>(event),
-                         (n <= USHRT_MAX) ? (unsigned short) n : USHRT_MAX);
+        rc = logbuf->stage(LOG_ID_EVENTS, now, uid, pid, tid,
+                           reinterpret_cast<char *>(event),
+                           (n <= USHRT_MAX) ? (unsigned short) n : USHRT_MAX);
         if (rc >= 0) {
             notify = true;
         }
@@ -227,8 +258,8 @@ int LogAudit::logPrint(const char *fmt, ...) {
         strncpy(newstr + 1 + l, str, b);
         strncpy(newstr + 1 + l + b, ecomm, e);
 
-        rc = logbuf->log(LOG_ID_MAIN, now, uid, pid, tid, newstr,
-                         (n <= USHRT_MAX) ? (unsigned short) n : USHRT_MAX);
+        rc = logbuf->stage(LOG_ID_MAIN, now, uid, pid, tid, newstr,
+                           (n <= USHRT_MAX) ? (unsigned short) n : USHRT_MAX);
 
         if (rc >= 0) {
             notify = true;
@@ -239,8 +270,8 @@ int LogAudit::logPrint(const char *fmt, ...) {
     free(const_cast<char *>(commfree));
     free(str);
 
+    // Stage messages, commit() adds them to the buffer
     if (notify) {
-        reader->notifyNewLog();
         if (rc < 0) {
             rc = n;
         }
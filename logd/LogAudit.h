@@ -31,7 +31,9 @@ class LogAudit : public SocketListener {
 
 public:
     LogAudit(LogBuffer *buf, LogReader *reader, int fdDmesg);
+    // Records are only staged, call commit() to add them to the buffer
     int log(char *buf, size_t len);
+    void commit();
     bool isMonotonic() { return logbuf->isMonotonic(); }
 
 protected:
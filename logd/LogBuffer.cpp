@@ -193,12 +193,31 @@ void LogBuffer::init() {
 
 LogBuffer::LogBuffer(LastLogTimes *times):
         monotonic(android_log_clockid() == CLOCK_MONOTONIC),
+        mStaged(NULL),
         mTimes(*times) {
     pthread_mutex_init(&mLogElementsLock, NULL);
 
     init();
 }
 
+// Checked without holding mLogElementsLock, msg is the element's payload
+bool LogBuffer::isLoggable(LogBufferElement *elem, const char *msg) {
+    log_id_t log_id = elem->getLogId();
+    if (log_id == LOG_ID_SECURITY) {
+        return true;
+    }
+
+    int prio = ANDROID_LOG_INFO;
+    const char *tag = NULL;
+    if (log_id == LOG_ID_EVENTS) {
+        tag = android::tagToName(elem->getTag());
+    } else {
+        prio = *msg;
+        tag = msg + 1;
+    }
+    return __android_log_is_loggable(prio, tag, ANDROID_LOG_VERBOSE);
+}
+
 int LogBuffer::log(log_id_t log_id, log_time realtime,
                    uid_t uid, pid_t pid, pid_t tid,
                    const char *msg, unsigned short len) {
@@ -208,30 +227,101 @@ int LogBuffer::log(log_id_t log_id, log_time realtime,
 
     LogBufferElement *elem = new LogBufferElement(log_id, realtime,
                                                   uid, pid, tid, msg, len);
-    if (log_id != LOG_ID_SECURITY) {
-        int prio = ANDROID_LOG_INFO;
-        const char *tag = NULL;
-        if (log_id == LOG_ID_EVENTS) {
-            tag = android::tagToName(elem->getTag());
+    if (!isLoggable(elem, msg)) {
+        // Log traffic received to total
+        pthread_mutex_lock(&mLogElementsLock);
+        stats.add(elem);
+        stats.subtract(elem);
+        pthread_mutex_unlock(&mLogElementsLock);
+        delete elem;
+        return -EACCES;
+    }
+
+    pthread_mutex_lock(&mLogElementsLock);
+    insertLocked(elem);
+    maybePrune(log_id);
+    pthread_mutex_unlock(&mLogElementsLock);
+
+    return len;
+}
+
+int LogBuffer::stage(log_id_t log_id, log_time realtime,
+                     uid_t uid, pid_t pid, pid_t tid,
+                     const char *msg, unsigned short len) {
+    if ((log_id >= LOG_ID_MAX) || (log_id < 0)) {
+        return -EINVAL;
+    }
+
+    LogBufferElement *elem = new LogBufferElement(log_id, realtime,
+                                                  uid, pid, tid, msg, len);
+    // Filtered elements are still staged so commit() accounts for them
+    bool loggable = isLoggable(elem, msg);
+    elem->mStagedLoggable = loggable;
+
+    // elem belongs to the stack once pushed, do not touch it after that
+    elem->mStagedNext = mStaged.load(std::memory_order_relaxed);
+    while (!mStaged.compare_exchange_weak(elem->mStagedNext, elem,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+
+    return loggable ? len : -EACCES;
+}
+
+size_t LogBuffer::commit() {
+    // Only ever take the whole stack, so there is no ABA on mStaged
+    LogBufferElement *staged = mStaged.exchange(NULL, std::memory_order_acquire);
+    if (!staged) {
+        return 0;
+    }
+
+    // The stack is newest first, restore arrival order
+    LogBufferElement *fifo = NULL;
+    while (staged) {
+        LogBufferElement *next = staged->mStagedNext;
+        staged->mStagedNext = fifo;
+        fifo = staged;
+        staged = next;
+    }
+
+    size_t count = 0;
+    bool touched[LOG_ID_MAX] = { false };
+
+    pthread_mutex_lock(&mLogElementsLock);
+
+    while (fifo) {
+        LogBufferElement *elem = fifo;
+        fifo = fifo->mStagedNext;
+        if (elem->mStagedLoggable) {
+            insertLocked(elem);
+            touched[elem->getLogId()] = true;
+            ++count;
         } else {
-            prio = *msg;
-            tag = msg + 1;
-        }
-        if (!__android_log_is_loggable(prio, tag, ANDROID_LOG_VERBOSE)) {
             // Log traffic received to total
-            pthread_mutex_lock(&mLogElementsLock);
             stats.add(elem);
             stats.subtract(elem);
-            pthread_mutex_unlock(&mLogElementsLock);
             delete elem;
-            return -EACCES;
         }
     }
 
-    pthread_mutex_lock(&mLogElementsLock);
+    // One prune pass per log id for the whole batch
+    log_id_for_each(id) {
+        if (touched[id]) {
+            maybePrune(id);
+        }
+    }
+
+    pthread_mutex_unlock(&mLogElementsLock);
+
+    return count;
+}
 
-    // Insert elements in time sorted order if possible
-    //  NB: if end is region locked, place element at end of list
+// Insert elements in time sorted order if possible
+//  NB: if end is region locked, place element at end of list
+//
+// mLogElementsLock must be held when this function is called.
+void LogBuffer::insertLocked(LogBufferElement *elem) {
+    log_time realtime = elem->getRealTime();
     LogBufferElementCollection::iterator it = mLogElements.end();
     LogBufferElementCollection::iterator last = it;
     while (last != mLogElements.begin()) {
@@ -278,10 +368,6 @@ int LogBuffer::log(log_id_t log_id, log_time realtime,
     }
 
     stats.add(elem);
-    maybePrune(log_id);
-    pthread_mutex_unlock(&mLogElementsLock);
-
-    return len;
 }
 
 // Prune at most 10% of the log entries or maxPrune, whichever is less.
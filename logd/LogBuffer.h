@@ -19,6 +19,7 @@
 
 #include <sys/types.h>
 
+#include <atomic>
 #include <list>
 #include <string>
 
@@ -100,6 +101,10 @@ class LogBuffer {
 
     bool monotonic;
 
+    // Lock-free stack of elements staged by stage() for the next commit(),
+    // linked through LogBufferElement::mStagedNext
+    std::atomic<LogBufferElement *> mStaged;
+
 public:
     LastLogTimes &mTimes;
 
@@ -110,6 +115,14 @@ public:
     int log(log_id_t log_id, log_time realtime,
             uid_t uid, pid_t pid, pid_t tid,
             const char *msg, unsigned short len);
+    // Same as log(), but only queues the element, without taking
+    // mLogElementsLock, for a later commit(). Safe from any thread.
+    int stage(log_id_t log_id, log_time realtime,
+              uid_t uid, pid_t pid, pid_t tid,
+              const char *msg, unsigned short len);
+    // Inserts everything staged so far under a single lock, returns the
+    // number of elements added to the buffer.
+    size_t commit();
     uint64_t flushTo(SocketClient *writer, const uint64_t start,
                      bool privileged, bool security,
                      int (*filter)(const LogBufferElement *element, void *arg) = NULL,
@@ -141,6 +154,8 @@ private:
     static constexpr size_t minPrune = 4;
     static constexpr size_t maxPrune = 256;
 
+    bool isLoggable(LogBufferElement *elem, const char *msg);
+    void insertLocked(LogBufferElement *elem);
     void maybePrune(log_id_t id);
     bool prune(log_id_t id, unsigned long pruneRows, uid_t uid = AID_ROOT);
     LogBufferElementCollection::iterator erase(
@@ -42,8 +42,10 @@ LogBufferElement::LogBufferElement(log_id_t log_id, log_time realtime,
         mPid(pid),
         mTid(tid),
         mMsgLen(len),
+        mStagedLoggable(false),
         mSequence(sequence.fetch_add(1, memory_order_relaxed)),
-        mRealTime(realtime) {
+        mRealTime(realtime),
+        mStagedNext(NULL) {
     mMsg = new char[len];
     memcpy(mMsg, msg, len);
 }
@@ -46,8 +46,11 @@ class LogBufferElement {
         const unsigned short mMsgLen; // mMSg != NULL
         unsigned short mDropped;      // mMsg == NULL
     };
+    // Only used between LogBuffer::stage() and LogBuffer::commit()
+    bool mStagedLoggable;
     const uint64_t mSequence;
     log_time mRealTime;
+    LogBufferElement *mStagedNext;
     static atomic_int_fast64_t sequence;
 
     // assumption: mMsg == NULL
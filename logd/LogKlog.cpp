@@ -268,6 +268,8 @@ bool LogKlog::onDataAvailable(SocketClient *cli) {
                 log(tok, sublen);
             }
         }
+        // Everything parsed from this read goes in under one lock
+        commit();
     }
 
     return true;
@@ -845,14 +847,14 @@ twoWord:    while (--taglen && !isspace(*++cp) && (*cp != ':'));
         }
     }
 
-    // Log message
-    int rc = logbuf->log(LOG_ID_KERNEL, now, uid, pid, tid, newstr,
+    // Stage message, commit() adds it to the buffer
+    return logbuf->stage(LOG_ID_KERNEL, now, uid, pid, tid, newstr,
                          (unsigned short) n);
+}
 
+void LogKlog::commit() {
     // notify readers
-    if (!rc) {
+    if (logbuf->commit()) {
         reader->notifyNewLog();
     }
-
-    return rc;
 }
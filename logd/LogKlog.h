@@ -42,7 +42,9 @@ class LogKlog : public SocketListener {
 
 public:
     LogKlog(LogBuffer *buf, LogReader *reader, int fdWrite, int fdRead, bool auditd);
+    // Records are only staged, call commit() to add them to the buffer
     int log(const char *buf, size_t len);
+    void commit();
     void synchronize(const char *buf, size_t len);
 
     bool isMonotonic() { return logbuf->isMonotonic(); }
@@ -361,6 +361,12 @@ static void readDmesg(LogAudit *al, LogKlog *kl) {
             rc = kl->log(tok, sublen);
         }
     }
+    if (al) {
+        al->commit();
+    }
+    if (kl) {
+        kl->commit();
+    }
 }
 
 // Foreground waits for exit of the main persistent threads
@@ -32,6 +32,7 @@
 #include "private/android_filesystem_config.h"
 #include "cutils/log.h"
 #include <cutils/klog.h>
+#include <log/logger.h>
 
 #define ARRAY_SIZE(x)   (sizeof(x) / sizeof(*(x)))
 #define MIN(a,b) (((a)<(b))?(a):(b))
@@ -52,6 +53,30 @@ do {                                                                          \
 
 #define MAX_KLOG_TAG 16
 
+/* Size of the buffer the child's output is read into.  It is drained
+ * completely every time the child writes, so a burst of output is taken
+ * off the pty in a few large reads rather than one poll() per 4K.
+ */
+#define LOG_BUF_SIZE 0x10000
+
+/* Read buffer on the stack, for when LOG_BUF_SIZE cannot be allocated */
+#define LOG_BUF_SIZE_FALLBACK 4096
+
+/* Lines bound for the Android log are coalesced into as few entries as
+ * possible, one write to logd per batch rather than per line.  logcat
+ * still prints each line of an entry with its own header.  A batch is
+ * submitted once it is full and whenever the child has no more output
+ * ready, so lines are never held back waiting for more.
+ */
+struct alog_batch {
+    char buf[LOGGER_ENTRY_MAX_PAYLOAD];
+    /* max_len is the usable space, leaving room for the priority and tag */
+    size_t max_len;
+    size_t len;
+    /* lines in buf, counted apart from len so that empty lines are kept */
+    size_t lines;
+};
+
 /* This is a simple buffer that holds up to the first beginning_buf->buf_size
  * bytes of output from a command.
  */
@@ -95,6 +120,7 @@ struct log_info {
     bool abbreviated;
     FILE *fp;
     struct abbr_buf a_buf;
+    struct alog_batch alog_batch;
 };
 
 /* Forware declaration */
@@ -154,13 +180,72 @@ static void add_line_to_circular_buf(struct ending_buf *e_buf,
     e_buf->write = (e_buf->write + line_len) % e_buf->buf_size;
 }
 
+static void init_alog_batch(struct log_info *log_info) {
+    struct alog_batch *batch = &log_info->alog_batch;
+    /* priority byte, tag and its terminator, and the message terminator */
+    size_t overhead = strlen(log_info->btag) + 3;
+
+    batch->len = 0;
+    batch->lines = 0;
+    if (overhead < sizeof(batch->buf) / 2) {
+        batch->max_len = sizeof(batch->buf) - overhead;
+    } else {
+        /* liblog truncates overlong tags anyway */
+        batch->max_len = sizeof(batch->buf) / 2;
+    }
+}
+
+/* Submit the pending lines to logd as a single entry */
+static void flush_alog_batch(struct log_info *log_info) {
+    struct alog_batch *batch = &log_info->alog_batch;
+
+    if (batch->lines) {
+        batch->buf[batch->len] = '\0';
+        __android_log_write(ANDROID_LOG_INFO, log_info->btag, batch->buf);
+        batch->len = 0;
+        batch->lines = 0;
+    }
+}
+
+static void add_line_to_alog_batch(struct log_info *log_info, const char *line) {
+    struct alog_batch *batch = &log_info->alog_batch;
+    size_t len = strlen(line);
+
+    /* Lines are joined with newlines, so drop the line's own */
+    while (len && line[len - 1] == '\n') {
+        len--;
+    }
+
+    /* Separator, if any, plus the line */
+    if (batch->lines && batch->len + 1 + len > batch->max_len) {
+        flush_alog_batch(log_info);
+    }
+    if (batch->lines) {
+        batch->buf[batch->len++] = '\n';
+    }
+
+    /* A line longer than a whole entry is split across several */
+    while (batch->len + len > batch->max_len) {
+        size_t chunk = batch->max_len - batch->len;
+        memcpy(batch->buf + batch->len, line, chunk);
+        batch->len += chunk;
+        batch->lines++;
+        flush_alog_batch(log_info);
+        line += chunk;
+        len -= chunk;
+    }
+    memcpy(batch->buf + batch->len, line, len);
+    batch->len += len;
+    batch->lines++;
+}
+
 /* Log directly to the specified log */
 static void do_log_line(struct log_info *log_info, char *line) {
     if (log_info->log_target & LOG_KLOG) {
         klog_write(6, log_info->klog_fmt, line);
     }
     if (log_info->log_target & LOG_ALOG) {
-        ALOG(LOG_INFO, log_info->btag, "%s", line);
+        add_line_to_alog_batch(log_info, line);
     }
     if (log_info->log_target & LOG_FILE) {
         fprintf(log_info->fp, "%s\n", line);
@@ -294,7 +379,9 @@ static int parent(const char *tag, int parent_read, pid_t pid,
         int *chld_sts, int log_target, bool abbreviated, char *file_path,
         const struct AndroidForkExecvpOption* opts, size_t opts_len) {
     int status = 0;
-    char buffer[4096];
+    char *buffer;
+    int buf_size = LOG_BUF_SIZE;
+    char fallback_buffer[LOG_BUF_SIZE_FALLBACK];
     struct pollfd poll_fds[] = {
         [0] = {
             .fd = parent_read,
@@ -316,6 +403,17 @@ static int parent(const char *tag, int parent_read, pid_t pid,
     if (!log_info.btag) {
         log_info.btag = (char*) tag;
     }
+    init_alog_batch(&log_info);
+
+    /* Carry on with a smaller buffer rather than leave the child unreaped */
+    buffer = malloc(buf_size);
+    if (!buffer) {
+        buffer = fallback_buffer;
+        buf_size = sizeof(fallback_buffer);
+    }
+
+    /* Reads must not block once the pty has been drained */
+    fcntl(parent_read, F_SETFL, fcntl(parent_read, F_GETFL) | O_NONBLOCK);
 
     if (abbreviated && (log_target == LOG_NONE)) {
         abbreviated = 0;
@@ -356,53 +454,55 @@ static int parent(const char *tag, int parent_read, pid_t pid,
         }
 
         if (poll_fds[0].revents & POLLIN) {
-            sz = TEMP_FAILURE_RETRY(
-                read(parent_read, &buffer[b], sizeof(buffer) - 1 - b));
-
-            for (size_t i = 0; sz > 0 && i < opts_len; ++i) {
-                if (opts[i].opt_type == FORK_EXECVP_OPTION_CAPTURE_OUTPUT) {
-                  opts[i].opt_capture_output.on_output(
-                      (uint8_t*)&buffer[b], sz, opts[i].opt_capture_output.user_pointer);
+            /* Drain everything the child has written so far */
+            while ((sz = TEMP_FAILURE_RETRY(
+                    read(parent_read, &buffer[b], buf_size - 1 - b))) > 0) {
+                for (size_t i = 0; i < opts_len; ++i) {
+                    if (opts[i].opt_type == FORK_EXECVP_OPTION_CAPTURE_OUTPUT) {
+                      opts[i].opt_capture_output.on_output(
+                          (uint8_t*)&buffer[b], sz, opts[i].opt_capture_output.user_pointer);
+                    }
                 }
-            }
 
-            sz += b;
-            // Log one line at a time
-            for (b = 0; b < sz; b++) {
-                if (buffer[b] == '\r') {
-                    if (abbreviated) {
-                        /* The abbreviated logging code uses newline as
-                         * the line separator.  Lucikly, the pty layer
-                         * helpfully cooks the output of the command
-                         * being run and inserts a CR before NL.  So
-                         * I just change it to NL here when doing
-                         * abbreviated logging.
-                         */
-                        buffer[b] = '\n';
-                    } else {
+                sz += b;
+                // Log one line at a time
+                for (b = 0; b < sz; b++) {
+                    if (buffer[b] == '\r') {
+                        if (abbreviated) {
+                            /* The abbreviated logging code uses newline as
+                             * the line separator.  Lucikly, the pty layer
+                             * helpfully cooks the output of the command
+                             * being run and inserts a CR before NL.  So
+                             * I just change it to NL here when doing
+                             * abbreviated logging.
+                             */
+                            buffer[b] = '\n';
+                        } else {
+                            buffer[b] = '\0';
+                        }
+                    } else if (buffer[b] == '\n') {
                         buffer[b] = '\0';
+                        log_line(&log_info, &buffer[a], b - a);
+                        a = b + 1;
                     }
-                } else if (buffer[b] == '\n') {
+                }
+
+                if (a == 0 && b == buf_size - 1) {
+                    // buffer is full, flush
                     buffer[b] = '\0';
                     log_line(&log_info, &buffer[a], b - a);
-                    a = b + 1;
+                    b = 0;
+                } else if (a != b) {
+                    // Keep left-overs
+                    b -= a;
+                    memmove(buffer, &buffer[a], b);
+                    a = 0;
+                } else {
+                    a = 0;
+                    b = 0;
                 }
             }
-
-            if (a == 0 && b == sizeof(buffer) - 1) {
-                // buffer is full, flush
-                buffer[b] = '\0';
-                log_line(&log_info, &buffer[a], b - a);
-                b = 0;
-            } else if (a != b) {
-                // Keep left-overs
-                b -= a;
-                memmove(buffer, &buffer[a], b);
-                a = 0;
-            } else {
-                a = 0;
-                b = 0;
-            }
+            flush_alog_batch(&log_info);
         }
 
         if (poll_fds[0].revents & POLLHUP) {
@@ -439,6 +539,7 @@ static int parent(const char *tag, int parent_read, pid_t pid,
     if (abbreviated) {
         print_abbr_buf(&log_info);
     }
+    flush_alog_batch(&log_info);
 
     if (WIFEXITED(status)) {
       if (WEXITSTATUS(status)) {
@@ -457,6 +558,7 @@ static int parent(const char *tag, int parent_read, pid_t pid,
         do_log_line(&log_info, tmpbuf);
       }
     }
+    flush_alog_batch(&log_info);
 
 err_waitpid:
 err_poll:
@@ -466,6 +568,9 @@ err_poll:
     if (abbreviated) {
         free_abbr_buf(&log_info.a_buf);
     }
+    if (buffer != fallback_buffer) {
+        free(buffer);
+    }
     return rc;
 }
 
@@ -3,7 +3,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := run-as.c package.c
 
-LOCAL_SHARED_LIBRARIES := libselinux
+LOCAL_SHARED_LIBRARIES := libselinux libpackagelistparser
 
 LOCAL_MODULE := run-as
 
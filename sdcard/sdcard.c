@@ -524,6 +524,32 @@ static void derive_permissions_recursive_locked(struct fuse* fuse, struct node *
     }
 }
 
+/* Re-derives only the package directories under Android/data, obb and media
+ * whose names are in |changed|. Everything else in the tree is independent
+ * of packages.list, so only the nodes leading to those directories are
+ * visited. */
+static void derive_permissions_changed_locked(struct fuse* fuse, struct node *parent,
+        Hashmap* changed) {
+    struct node *node;
+    for (node = parent->child; node; node = node->next) {
+        switch (parent->perm) {
+        case PERM_ANDROID_DATA:
+        case PERM_ANDROID_OBB:
+        case PERM_ANDROID_MEDIA:
+            if (hashmapContainsKey(changed, node->name)) {
+                derive_permissions_locked(fuse, parent, node);
+                derive_permissions_recursive_locked(fuse, node);
+            }
+            break;
+        default:
+            if (node->perm != PERM_INHERIT) {
+                derive_permissions_changed_locked(fuse, node, changed);
+            }
+            break;
+        }
+    }
+}
+
 /* Kernel has already enforced everything we returned through
  * derive_permissions_locked(), so this is used to lock down access
  * even further, such as enforcing that apps hold sdcard_rw. */
@@ -1705,30 +1731,77 @@ static bool remove_str_to_int(void *key, void *value, void *context) {
     return true;
 }
 
-static bool package_parse_callback(pkg_info *info, void *userdata) {
-    struct fuse_global *global = (struct fuse_global *)userdata;
+struct package_diff {
+    Hashmap* other;
+    Hashmap* changed;
+};
 
-    char* name = strdup(info->name);
-    hashmapPut(global->package_to_appid, name, (void*) (uintptr_t) info->uid);
-    packagelist_free(info);
+/* Records |key| as changed unless |other| maps it to the same appid. */
+static bool diff_package(void *key, void *value, void *context) {
+    struct package_diff* diff = context;
+    if (hashmapGet(diff->other, key) != value) {
+        hashmapPut(diff->changed, key, key);
+    }
     return true;
 }
 
 static bool read_package_list(struct fuse_global* global) {
-    pthread_mutex_lock(&global->lock);
-
-    hashmapForEach(global->package_to_appid, remove_str_to_int, global->package_to_appid);
+    /* Only this thread ever replaces the map, so the old one can be read
+     * and the new one built without holding the lock. */
+    Hashmap* old_map = global->package_to_appid;
+    Hashmap* new_map = hashmapCreate(hashmapSize(old_map) + 16, str_hash, str_icase_equals);
+    Hashmap* changed = hashmapCreate(16, str_hash, str_icase_equals);
+    if (!new_map || !changed) {
+        ERROR("failed to allocate package maps\n");
+        if (new_map) hashmapFree(new_map);
+        if (changed) hashmapFree(changed);
+        return false;
+    }
 
-    bool rc = packagelist_parse(package_parse_callback, global);
-    TRACE("read_package_list: found %zu packages\n",
-            hashmapSize(global->package_to_appid));
+    packagelist* list = packagelist_map(PACKAGES_LIST_FILE);
+    if (!list) {
+        ERROR("failed to map %s: %s\n", PACKAGES_LIST_FILE, strerror(errno));
+        hashmapFree(new_map);
+        hashmapFree(changed);
+        return false;
+    }
+    /* Keep the previous map rather than installing a partial one */
+    if (packagelist_malformed(list)) {
+        ERROR("%s is malformed, keeping the previous package map\n", PACKAGES_LIST_FILE);
+        packagelist_unmap(list);
+        hashmapFree(new_map);
+        hashmapFree(changed);
+        return false;
+    }
+    size_t i;
+    for (i = 0; i < packagelist_size(list); i++) {
+        const pkg_entry* entry = packagelist_entry(list, i);
+        char* name = strndup(entry->name.data, entry->name.len);
+        hashmapPut(new_map, name, (void*) (uintptr_t) entry->uid);
+    }
+    packagelist_unmap(list);
+    TRACE("read_package_list: found %zu packages\n", hashmapSize(new_map));
 
-    /* Regenerate ownership details using newly loaded mapping */
-    derive_permissions_recursive_locked(global->fuse_default, &global->root);
+    struct package_diff diff = { new_map, changed };
+    hashmapForEach(old_map, diff_package, &diff);
+    diff.other = old_map;
+    hashmapForEach(new_map, diff_package, &diff);
+    TRACE("read_package_list: %zu packages changed\n", hashmapSize(changed));
 
+    pthread_mutex_lock(&global->lock);
+    global->package_to_appid = new_map;
+    /* Regenerate ownership details for packages whose appid changed */
+    if (hashmapSize(changed) > 0) {
+        derive_permissions_changed_locked(global->fuse_default, &global->root, changed);
+    }
     pthread_mutex_unlock(&global->lock);
 
-    return rc;
+    /* |changed| borrows keys from both maps, so drop it first */
+    hashmapFree(changed);
+    hashmapForEach(old_map, remove_str_to_int, old_map);
+    hashmapFree(old_map);
+
+    return true;
 }
 
 static void watch_package_list(struct fuse_global* global) {